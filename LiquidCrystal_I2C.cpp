@@ -9,26 +9,49 @@
 
 #include "LiquidCrystal_I2C.h"
 #include <inttypes.h>
+
+// Expander bytes per nibble and per send() (two nibbles).
+#define LCD_NIBBLE_BYTES 3
+#define LCD_SEND_BYTES (2 * LCD_NIBBLE_BYTES)
+
+// Sends packed per push onto the TWI queue (bounds our stack buffer).
+#define LCD_SENDS_PER_BATCH 5
+
+// Clear and home take up to 1.52ms to execute.
+#define LCD_SLOW_COMMAND_MICROS 2000
 #if defined(ARDUINO) && ARDUINO >= 100
 
 #include "Arduino.h"
 
-#define printIIC(args)	Wire.write(args)
 inline size_t LiquidCrystal_I2C::write(uint8_t value) {
 	send(value, Rs);
 	return 0;
 }
 
+// Write a run of characters, packing several at a time onto the TWI
+// queue.
+size_t LiquidCrystal_I2C::write(const uint8_t *buffer, size_t size) {
+	uint8_t buf[LCD_SEND_BYTES * LCD_SENDS_PER_BATCH];
+	size_t n = 0;
+	while (n < size) {
+		uint8_t *p = buf;
+		while (n < size && p < buf + sizeof(buf)) {
+			p = packSend(p, buffer[n++], Rs);
+		}
+		expanderWriteBatch(buf, p - buf);
+	}
+	return n;
+}
+
 #else
 #include "WProgram.h"
 
-#define printIIC(args)	Wire.send(args)
 inline void LiquidCrystal_I2C::write(uint8_t value) {
 	send(value, Rs);
 }
 
 #endif
-#include <Wire.h>
+#include "twi_queue.h"
 
 
 
@@ -65,7 +88,7 @@ void LiquidCrystal_I2C::init(){
 
 void LiquidCrystal_I2C::init_priv()
 {
-	Wire.begin();
+	twi_queue_begin(_Addr);
 	_displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
 	begin(_cols, _rows);  
 }
@@ -133,12 +156,12 @@ void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 /********** high level commands, for the user! */
 void LiquidCrystal_I2C::clear(){
 	command(LCD_CLEARDISPLAY);// clear display, set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
+	slowCommandWait();  // this command takes a long time!
 }
 
 void LiquidCrystal_I2C::home(){
 	command(LCD_RETURNHOME);  // set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
+	slowCommandWait();  // this command takes a long time!
 }
 
 void LiquidCrystal_I2C::setCursor(uint8_t col, uint8_t row){
@@ -243,32 +266,72 @@ inline void LiquidCrystal_I2C::command(uint8_t value) {
 
 /************ low level data pushing commands **********/
 
+// Every nibble goes to the expander as three bytes: the data, the data
+// with En high, and the data with En low (which latches it).  Those
+// bytes are streamed back to back from the TWI queue rather than in a
+// transaction each, and we let the bus do the timing: each byte takes
+// nine SCL periods (90us at 100kHz, 22.5us at 400kHz), so the enable
+// pulse is far longer than the 450ns minimum, and at least two bytes
+// (or a restart plus address) go by after En falls before the next
+// enable pulse, which covers the 37us the LCD needs to settle.
+
 // write either command or data
 void LiquidCrystal_I2C::send(uint8_t value, uint8_t mode) {
-	uint8_t highnib=value&0xf0;
-	uint8_t lownib=(value<<4)&0xf0;
-       write4bits((highnib)|mode);
-	write4bits((lownib)|mode); 
+	uint8_t buf[LCD_SEND_BYTES];
+	packSend(buf, value, mode);
+	expanderWriteBatch(buf, LCD_SEND_BYTES);
 }
 
 void LiquidCrystal_I2C::write4bits(uint8_t value) {
-	expanderWrite(value);
-	pulseEnable(value);
+	uint8_t buf[LCD_NIBBLE_BYTES];
+	packNibble(buf, value);
+	expanderWriteBatch(buf, LCD_NIBBLE_BYTES);
+	twi_queue_flush();
+}
+
+// Pack the expander bytes for one nibble (in the top four bits of
+// value, with the mode bits) into buf; returns the end of what was
+// written.
+uint8_t *LiquidCrystal_I2C::packNibble(uint8_t *buf, uint8_t value) {
+	value |= _backlightval;
+	*buf++ = value;
+	*buf++ = value | En;	// En high
+	*buf++ = value & ~En;	// En low
+	return buf;
 }
 
+uint8_t *LiquidCrystal_I2C::packSend(uint8_t *buf, uint8_t value, uint8_t mode) {
+	uint8_t highnib=value&0xf0;
+	uint8_t lownib=(value<<4)&0xf0;
+	buf = packNibble(buf, highnib|mode);
+	return packNibble(buf, lownib|mode);
+}
+
+// write4bits() and expanderWrite() are only used for initialisation
+// and backlight changes, so they wait for their bytes to reach the
+// display; that keeps the datasheet delays in begin() honest.
 void LiquidCrystal_I2C::expanderWrite(uint8_t _data){                                        
-	Wire.beginTransmission(_Addr);
-	printIIC((int)(_data) | _backlightval);
-	Wire.endTransmission();   
+	uint8_t data = _data | _backlightval;
+	twi_queue_push(&data, 1);
+	twi_queue_flush();
 }
 
-void LiquidCrystal_I2C::pulseEnable(uint8_t _data){
-	expanderWrite(_data | En);	// En high
-	delayMicroseconds(1);		// enable pulse must be >450ns
-	
-	expanderWrite(_data & ~En);	// En low
-	delayMicroseconds(50);		// commands need > 37us to settle
-} 
+// Everything else is queued and sent from the TWI interrupt.
+void LiquidCrystal_I2C::expanderWriteBatch(const uint8_t *buf, uint8_t len){
+	twi_queue_push(buf, len);
+}
+
+// Wait out a slow command by queueing idle expander writes behind it,
+// rather than blocking the CPU.
+void LiquidCrystal_I2C::slowCommandWait(){
+	twi_queue_repeat(_backlightval,
+	                 LCD_SLOW_COMMAND_MICROS / TwiQueueByteTimeMicros + 1);
+}
+
+// Block until everything queued is on the display.
+void LiquidCrystal_I2C::flush(){
+	twi_queue_flush();
+}
 
 
 // Alias functions
@@ -4,7 +4,6 @@
 
 #include <inttypes.h>
 #include "Print.h" 
-#include <Wire.h>
 
 // commands
 #define LCD_CLEARDISPLAY 0x01
@@ -80,12 +79,18 @@ public:
   void setCursor(uint8_t, uint8_t); 
 #if defined(ARDUINO) && ARDUINO >= 100
   virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
 #else
   virtual void write(uint8_t);
 #endif
   void command(uint8_t);
   void init();
 
+  // Output is queued and sent from the TWI interrupt; flush() waits
+  // until it has all reached the display.
+  virtual void flush();
+
 ////compatibility API function aliases
 void blink_on();						// alias for blink()
 void blink_off();       					// alias for noBlink()
@@ -112,7 +117,10 @@ private:
   void send(uint8_t, uint8_t);
   void write4bits(uint8_t);
   void expanderWrite(uint8_t);
-  void pulseEnable(uint8_t);
+  void expanderWriteBatch(const uint8_t *, uint8_t);
+  void slowCommandWait();
+  uint8_t *packNibble(uint8_t *, uint8_t);
+  uint8_t *packSend(uint8_t *, uint8_t, uint8_t);
   uint8_t _Addr;
   uint8_t _displayfunction;
   uint8_t _displaycontrol;
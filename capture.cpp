@@ -0,0 +1,278 @@
+#include "capture.h"
+
+#include <stdint.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "Arduino.h"
+
+#include "printf.h"
+#include "relays.h"
+
+uint8_t const CaptureTicksPerMicro = 2;
+
+static CaptureEngine *volatile capture_instance = NULL;
+
+// Time between start() and the first edge, so that the first compare
+// value is safely in the future when we program it.
+static uint16_t const Capture_start_lead_ticks = 64;
+
+uint16_t const CaptureTriggerLeadTicks = Capture_start_lead_ticks;
+
+// The trigger interrupt must have OCR5A programmed at least this long
+// before timeline time zero, or the compare could be missed.
+static uint16_t const Capture_trigger_margin_ticks = 16;
+
+// Largest distance we'll program into OCR5A in one go.  Longer gaps
+// are split into several compares; keeping them well under 0x10000
+// means a slightly late ISR can never make us miss a compare and wait
+// for the counter to wrap.
+static uint16_t const Capture_max_chunk_ticks = 0x8000;
+
+// Edges closer together than this are not worth leaving the ISR for;
+// we spin on TCNT5 instead.
+static uint16_t const Capture_min_compare_ticks = 48;
+
+static inline void enable_timer5_interrupt() {
+    TIMSK5 |= _BV(OCIE5A);
+}
+
+static inline void disable_timer5_interrupt() {
+    TIMSK5 &= ~_BV(OCIE5A);
+}
+
+static inline void enable_trigger_interrupt() {
+    TIMSK5 |= _BV(ICIE5);
+}
+
+static inline void disable_trigger_interrupt() {
+    TIMSK5 &= ~_BV(ICIE5);
+}
+
+// Set up timer5 as a free-running timebase for captures
+static void setup_timer5() {
+    disable_timer5_interrupt();
+    disable_trigger_interrupt();
+
+    // WGM5 = 0000 (normal mode, count to 0xffff and wrap)
+    TCCR5A = 0x00;
+    TCCR5B &= ~_BV(WGM52);
+    TCCR5B &= ~_BV(WGM53);
+
+    // CS5 = 010 = clkIO/8
+    TCCR5B &= ~_BV(CS52);
+    TCCR5B |= _BV(CS51);
+    TCCR5B &= ~_BV(CS50);
+
+    // Input capture on ICP5 (PL1): falling edge, with the noise
+    // canceller on.  The canceller delays the capture by a fixed four
+    // CPU cycles, which is well under a tick.
+    DDRL &= ~_BV(DDL1);
+    PORTL |= _BV(PL1);
+    TCCR5B &= ~_BV(ICES5);
+    TCCR5B |= _BV(ICNC5);
+}
+
+//
+// CaptureEngine class implementation
+//
+
+CaptureEngine::CaptureEngine() : _events(NULL),
+                                 _num_events(0),
+                                 _next_event(0),
+                                 _remaining_ticks(0),
+                                 _start_ticks(0),
+                                 _max_jitter_ticks(0),
+                                 _running(false),
+                                 _trigger_armed(false),
+                                 _late_triggers(0) {
+    if (capture_instance) {
+        dprintf("Attempt to initialize a capture engine when one exists\n");
+        return;
+    }
+
+    capture_instance = this;
+
+    setup_timer5();
+}
+
+CaptureEngine::~CaptureEngine() {
+    disable_timer5_interrupt();
+    disable_trigger_interrupt();
+    capture_instance = NULL;
+}
+
+void CaptureEngine::start(CaptureTimeline const &timeline) {
+    if (timeline.get_num_events() == 0) {
+        return;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        load(timeline);
+        begin(TCNT5 + Capture_start_lead_ticks);
+    }
+}
+
+void CaptureEngine::arm_trigger(CaptureTimeline const &timeline) {
+    if (timeline.get_num_events() == 0) {
+        return;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        load(timeline);
+        _trigger_armed = true;
+
+        // Forget any edge that came before we were armed
+        TIFR5 |= _BV(ICF5);
+        enable_trigger_interrupt();
+    }
+}
+
+// Take on a new timeline.  Call with interrupts disabled.
+void CaptureEngine::load(CaptureTimeline const &timeline) {
+    _events = &timeline.get_event(0);
+    _num_events = timeline.get_num_events();
+    _next_event = 0;
+    _max_jitter_ticks = 0;
+}
+
+// Start the loaded timeline with time zero at the given TCNT5 value,
+// which must be at least a few ticks in the future.  Call with
+// interrupts disabled.
+void CaptureEngine::begin(uint16_t start_ticks) {
+    _running = true;
+
+    _start_ticks = start_ticks;
+    OCR5A = start_ticks;
+    _remaining_ticks = _events[0].time_us * CaptureTicksPerMicro;
+
+    // Clear the interrupt in case it became set while disabled
+    TIFR5 |= _BV(OCF5A);
+
+    if (_remaining_ticks > 0) {
+        program_next_compare();
+    }
+
+    enable_timer5_interrupt();
+}
+
+void CaptureEngine::abort() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        disable_timer5_interrupt();
+        disable_trigger_interrupt();
+        _running = false;
+        _trigger_armed = false;
+    }
+
+    open_all_relays();
+}
+
+int16_t CaptureEngine::get_edge_error_ticks(uint8_t index) const {
+    // Only the low 16 bits of the setpoint matter; the difference is
+    // right as long as the edge was less than 16 ms late.
+    uint16_t setpoint = _start_ticks + (uint16_t)(_events[index].time_us * CaptureTicksPerMicro);
+    return (int16_t)(_edge_ticks[index] - setpoint);
+}
+
+unsigned long CaptureEngine::get_edge_time_us(uint8_t index) const {
+    long ticks = Capture_start_lead_ticks
+        + (long)(_events[index].time_us * CaptureTicksPerMicro)
+        + get_edge_error_ticks(index);
+    return ticks / CaptureTicksPerMicro;
+}
+
+// Advance OCR5A towards the next edge by at most one chunk.
+void CaptureEngine::program_next_compare() {
+    unsigned long remaining = _remaining_ticks;
+    uint16_t chunk;
+
+    if (remaining <= Capture_max_chunk_ticks) {
+        chunk = remaining;
+    } else if (remaining < 2UL * Capture_max_chunk_ticks) {
+        // Split evenly so the final chunk isn't uselessly short
+        chunk = remaining / 2;
+    } else {
+        chunk = Capture_max_chunk_ticks;
+    }
+
+    _remaining_ticks = remaining - chunk;
+    OCR5A += chunk;
+}
+
+void CaptureEngine::handle_compare() {
+    if (_remaining_ticks > 0) {
+        // Still counting down a long gap
+        program_next_compare();
+        return;
+    }
+
+    for (;;) {
+        uint8_t index = _next_event;
+        unsigned long now_us = _events[index].time_us;
+
+        // Replay every port write scheduled for this instant
+        do {
+            CaptureEvent const &e = _events[index];
+            *e.port = (*e.port & ~e.clear_mask) | e.set_mask;
+            _edge_ticks[index] = TCNT5;
+            index++;
+        } while (index < _num_events && _events[index].time_us == now_us);
+
+        uint16_t late = TCNT5 - OCR5A;
+        if (late > _max_jitter_ticks) {
+            _max_jitter_ticks = late;
+        }
+
+        _next_event = index;
+
+        if (index >= _num_events) {
+            disable_timer5_interrupt();
+            _running = false;
+            return;
+        }
+
+        _remaining_ticks = (_events[index].time_us - now_us) * CaptureTicksPerMicro;
+
+        if (_remaining_ticks >= Capture_min_compare_ticks) {
+            program_next_compare();
+            return;
+        }
+
+        // Next edge is too close to return from the ISR and come
+        // back; wait for it here.
+        uint16_t target = OCR5A + (uint16_t)_remaining_ticks;
+        while ((int16_t)(TCNT5 - target) < 0);
+        OCR5A = target;
+        _remaining_ticks = 0;
+    }
+}
+
+void CaptureEngine::handle_trigger() {
+    uint16_t trigger_ticks = ICR5;
+
+    disable_trigger_interrupt();
+    _trigger_armed = false;
+
+    uint16_t start_ticks = trigger_ticks + CaptureTriggerLeadTicks;
+
+    // If something held us off for so long that time zero is about to
+    // pass, start as soon as we can instead of missing the compare and
+    // waiting for the timer to wrap.
+    uint16_t elapsed = TCNT5 - trigger_ticks;
+    if (elapsed + Capture_trigger_margin_ticks > CaptureTriggerLeadTicks) {
+        start_ticks = TCNT5 + Capture_trigger_margin_ticks;
+        _late_triggers++;
+    }
+
+    begin(start_ticks);
+}
+
+ISR(TIMER5_COMPA_vect) {
+    capture_instance->handle_compare();
+}
+
+ISR(TIMER5_CAPT_vect) {
+    capture_instance->handle_trigger();
+}
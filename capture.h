@@ -0,0 +1,110 @@
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdint.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include "capture_timeline.h"
+
+// Timer5 runs at clkIO/8, so each tick is half a microsecond.
+extern uint8_t const CaptureTicksPerMicro;
+
+// Time from the trigger edge latched by the input capture unit to
+// timeline time zero, in timer ticks.
+extern uint16_t const CaptureTriggerLeadTicks;
+
+class CaptureEngine {
+
+public:
+
+    CaptureEngine();
+    virtual ~CaptureEngine();
+
+    // Begin replaying the timeline.  Returns immediately; the events
+    // are driven from the timer interrupt.  The timeline must not be
+    // modified until the capture has finished.
+    void start(CaptureTimeline const &timeline);
+
+    // Start the timeline from an external trigger instead of right
+    // away: a falling edge on ICP5 (PL1, digital pin 48).  The edge
+    // time is latched by Timer5's input capture unit, and the timeline
+    // starts exactly CaptureTriggerLeadTicks after it, however long
+    // the interrupt took to get around to it.  Same rules about the
+    // timeline as start().
+    void arm_trigger(CaptureTimeline const &timeline);
+
+    // Stop the capture (or stop waiting for the trigger) immediately
+    // and open every relay.
+    void abort();
+
+    inline bool is_running() const {
+        return _running;
+    }
+
+    inline bool is_trigger_armed() const {
+        return _trigger_armed;
+    }
+
+    // Triggers that the interrupt got to too late to honour the lead
+    // time; those captures started as soon as possible instead.
+    inline uint16_t get_late_triggers() const {
+        return _late_triggers;
+    }
+
+    // Worst lateness of any edge in the last capture, measured from
+    // the output-compare match to the port write, in timer ticks (see
+    // CaptureTicksPerMicro).
+    inline uint16_t get_max_jitter_ticks() const {
+        return _max_jitter_ticks;
+    }
+
+    // Number of timeline events written out so far in the current (or
+    // last) capture; less than the timeline's count if it was aborted.
+    inline uint8_t get_num_edges_done() const {
+        return _next_event;
+    }
+
+    // How late event index's port write was compared to its place in
+    // the timeline, in timer ticks.  Only valid below
+    // get_num_edges_done().
+    int16_t get_edge_error_ticks(uint8_t index) const;
+
+    // When event index's port write happened, in microseconds from the
+    // start() call (or from the trigger edge).  Same limits as
+    // get_edge_error_ticks().
+    unsigned long get_edge_time_us(uint8_t index) const;
+
+    // Called from the timer5 compare interrupt.  This only does the
+    // port writes and notes TCNT5 after each; anything worked out from
+    // those times is done by the caller once the capture has finished.
+    void handle_compare();
+
+    // Called from the timer5 input capture interrupt.
+    void handle_trigger();
+
+private:
+
+    void load(CaptureTimeline const &timeline);
+    void begin(uint16_t start_ticks);
+    void program_next_compare();
+
+    CaptureEvent const *_events;
+    uint8_t _num_events;
+
+    volatile uint8_t _next_event;
+    volatile unsigned long _remaining_ticks;
+
+    // TCNT5 at timeline time zero, and right after each event's port
+    // write.
+    uint16_t _start_ticks;
+    volatile uint16_t _edge_ticks[CaptureTimeline::MaxEvents];
+
+    volatile uint16_t _max_jitter_ticks;
+    volatile bool _running;
+    volatile bool _trigger_armed;
+    volatile uint16_t _late_triggers;
+};
+
+#endif
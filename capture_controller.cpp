@@ -0,0 +1,337 @@
+#include "capture_controller.h"
+
+#include <stdint.h>
+
+#include "Arduino.h"
+
+#include "constants.h"
+#include "edge_recorder.h"
+#include "latency.h"
+#include "lcd_line.h"
+#include "log.h"
+#include "menu_builder.h"
+#include "printf.h"
+#include "relays.h"
+#include "valve_sequence.h"
+
+static uint8_t const Capture_max_queued_starts = 8;
+
+// How often to refresh the time remaining on the LCD.
+static unsigned long const Capture_status_interval_ms = 100;
+
+//
+// CaptureController class implementation
+//
+
+CaptureController::CaptureController(LcdFrameBuffer &display, CaptureEngine &capture)
+    : _display(display),
+      _capture(capture),
+      _sweeping(false),
+      _state(StateIdle),
+      _state_started_ms(0),
+      _state_length_ms(0),
+      _last_status_ms(0),
+      _camera_held_cued(false),
+      _queued_starts(0),
+      _trigger_engine_armed(false),
+      _late_triggers(0),
+      _engine_start_us(0) {
+}
+
+void CaptureController::request_start() {
+    if (_queued_starts < Capture_max_queued_starts) {
+        _queued_starts++;
+    }
+}
+
+void CaptureController::abort() {
+    bool was_capturing = (_state == StateCapturing);
+    _capture.abort();
+
+    if (was_capturing) {
+        edge_recorder_add(_timeline, _capture);
+    }
+    latency_end();
+
+    _camera_held_cued = false;
+    _queued_starts = 0;
+    _sweeping = false;
+    _state = StateIdle;
+
+    log_event(LogCaptureAborted);
+}
+
+bool CaptureController::tick() {
+    switch (_state) {
+
+    case StateIdle:
+        // Let go of the camera once burst mode is turned off
+        if (_camera_held_cued && !get_capture_settings().keep_camera_cued) {
+            CueShutterRelay::open();
+            _camera_held_cued = false;
+        }
+
+        if (_queued_starts == 0) {
+            return false;
+        }
+        _queued_starts--;
+
+        _sweeping = get_capture_settings().sweeping;
+        if (_sweeping) {
+            _sweep = get_capture_settings().sweep;
+            _sweep.rewind();
+
+            log_event(LogSweepStart,
+                      _sweep.get_num_shots(), get_capture_settings().sweep_settle_time_ms);
+        }
+
+        // A capture that can't start leaves its reason on the display
+        // until the menu next redraws
+        start_capture();
+        return false;
+
+    case StateArmed:
+        if (!_trigger_engine_armed) {
+            if (millis() - _state_started_ms < _state_length_ms) {
+                show_status(false);
+                return false;
+            }
+
+            // The trigger can fire as soon as the engine is armed, so
+            // get the capture's status out to the LCD first; nothing is
+            // drawn again until the last edge is done.
+            _trigger_engine_armed = true;
+            show_status(true);
+            _display.wait_until_displayed();
+
+            // The key press trace stops here; what happens next is
+            // timed from the trigger
+            latency_end();
+            _capture.arm_trigger(_timeline);
+            return false;
+        }
+
+        if (_capture.is_trigger_armed()) {
+            return false;
+        }
+
+        // Not enter_state(), which would redraw under the timeline
+        _state = StateCapturing;
+        _state_started_ms = millis();
+        _state_length_ms = _timeline.get_duration_us() / 1000;
+        return false;
+
+    case StateCapturing:
+        if (_capture.is_running()) {
+            if (!_trigger_engine_armed) {
+                show_status(false);
+            }
+            return false;
+        }
+
+        finish_capture();
+
+        if (_sweeping) {
+            _sweep.advance();
+            if (!_sweep.is_finished()) {
+                enter_state(StateSettling, get_capture_settings().sweep_settle_time_ms);
+                return false;
+            }
+
+            // Don't start another whole sweep for presses made during
+            // this one
+            _queued_starts = 0;
+            _sweeping = false;
+            log_event(LogSweepDone);
+        }
+
+        _state = StateIdle;
+        return !is_busy();
+
+    case StateSettling:
+        if (millis() - _state_started_ms < _state_length_ms) {
+            show_status(false);
+            return false;
+        }
+
+        // A capture that can't start leaves its reason on the display
+        // until the menu next redraws
+        start_capture();
+        return false;
+    }
+
+    return false;
+}
+
+void CaptureController::start_capture() {
+    latency_mark(LatencyCaptureStart);
+
+    CaptureSettings const &settings = get_capture_settings();
+    ValveSequence sequence = settings.sequence;
+
+    // Rather than time the shutter from some other drop
+    if (!sequence.has_shutter_reference()) {
+        log_event(LogShutterRefOff);
+        refuse_capture(PSTR("Ref drop is off"));
+        return;
+    }
+
+    if (_sweeping) {
+        unsigned long open_time = _sweep.get_open_time();
+        unsigned long shutter_time = _sweep.get_shutter_time();
+
+        sequence.set_pulse_open_time(0, open_time);
+        sequence.set_shutter_delay(shutter_time);
+
+        log_event(LogSweepShot,
+                  _sweep.get_shot() + 1, _sweep.get_num_shots(),
+                  open_time, shutter_time);
+    }
+
+    // In burst mode we only pay ShutterPrepareTimeMillis for the first
+    // shot.  Check the relay too, in case something else (eg. the
+    // manual control abort) has let go of the cue since.
+    bool camera_cued = _camera_held_cued && CueShutterRelay::is_closed();
+
+    // A triggered capture cues the camera itself before arming, so the
+    // timeline starts with the camera ready.
+    bool use_trigger = settings.use_sensor_trigger;
+    sequence.set_cue(camera_cued || use_trigger, settings.keep_camera_cued);
+
+    // Compile the whole sequence up front so that nothing but port
+    // writes happens once the capture is under way.
+    if (!sequence.compile(_timeline)) {
+        log_event(LogTimelineFull);
+        refuse_capture(PSTR("Too many edges"));
+        return;
+    }
+
+    if (use_trigger) {
+        if (!camera_cued) {
+            CueShutterRelay::close();
+        }
+
+        _trigger_engine_armed = false;
+        enter_state(StateArmed, camera_cued ? 0 : ShutterPrepareTimeMillis);
+        return;
+    }
+
+    // Get "Capturing..." onto the display before the capture starts,
+    // so the LCD traffic is out of the way of the first edges.
+    _trigger_engine_armed = false;
+    enter_state(StateCapturing, _timeline.get_duration_us() / 1000);
+    _display.wait_until_displayed();
+
+    _engine_start_us = micros();
+    latency_mark_at(LatencyEngineStart, _engine_start_us);
+    _capture.start(_timeline);
+    _state_started_ms = millis();
+}
+
+void CaptureController::refuse_capture(char const *reason) {
+    latency_end();
+    _queued_starts = 0;
+    _sweeping = false;
+    _state = StateIdle;
+
+    LcdLine line;
+    line.append_P(PSTR("Can't capture:"));
+    _display.set_line(0, line.get_text());
+
+    line.clear();
+    line.append_P(reason);
+    _display.set_line(1, line.get_text());
+    _display.flush();
+}
+
+void CaptureController::finish_capture() {
+    _camera_held_cued = get_capture_settings().keep_camera_cued;
+    edge_recorder_add(_timeline, _capture);
+
+    if (_capture.get_late_triggers() != _late_triggers) {
+        _late_triggers = _capture.get_late_triggers();
+        log_event(LogTriggerLate);
+    }
+
+    // The engine only kept the raw edge times; work out the latency
+    // stages from them now that the timing is over.  A triggered
+    // capture's trace already ended when it was armed.
+    uint8_t num_edges = _capture.get_num_edges_done();
+    if (num_edges > 0) {
+        latency_mark_at(LatencyFirstEdge, _engine_start_us + _capture.get_edge_time_us(0));
+    }
+    latency_end();
+
+    for (uint8_t i = 0; i < num_edges; i++) {
+        int16_t error = _capture.get_edge_error_ticks(i);
+        latency_record(LatencyEdgeLate, (error > 0) ? error / CaptureTicksPerMicro : 0);
+    }
+
+    uint16_t jitter = _capture.get_max_jitter_ticks();
+    log_event(LogCaptureDone,
+              jitter / CaptureTicksPerMicro,
+              (jitter % CaptureTicksPerMicro) * 10 / CaptureTicksPerMicro);
+
+#ifdef LOG_BINARY
+    for (uint8_t i = 0; i < num_edges; i++) {
+        CaptureEvent const &event = _timeline.get_event(i);
+        log_trace(LogCaptureEdge, i, event.time_us,
+                  event.set_mask, event.clear_mask,
+                  _capture.get_edge_error_ticks(i));
+    }
+#endif
+}
+
+void CaptureController::enter_state(State state, unsigned long length_ms) {
+    _state = state;
+    _state_started_ms = millis();
+    _state_length_ms = length_ms;
+    show_status(true);
+}
+
+void CaptureController::show_status(bool force) {
+    unsigned long now = millis();
+
+    if (!force && now - _last_status_ms < Capture_status_interval_ms) {
+        return;
+    }
+    _last_status_ms = now;
+
+    unsigned long elapsed = now - _state_started_ms;
+    unsigned long remaining = (elapsed < _state_length_ms) ? _state_length_ms - elapsed : 0;
+
+    LcdLine line;
+
+    if (_sweeping) {
+        line.append_P(PSTR("Sweep "))
+            .append_number(_sweep.get_shot() + 1)
+            .append('/')
+            .append_number(_sweep.get_num_shots());
+    } else if (_state == StateArmed && !_trigger_engine_armed) {
+        line.append_P(PSTR("Sensor trigger"));
+    } else {
+        line.append_P(PSTR("Capturing..."));
+    }
+    _display.set_line(0, line.get_text());
+
+    if (_state == StateArmed) {
+        line.clear();
+        line.append_P(_trigger_engine_armed ? PSTR("Armed, B: cancel") : PSTR("Cueing camera..."));
+        _display.set_line(1, line.get_text());
+        _display.flush();
+        return;
+    }
+
+    line.clear();
+    if (_state == StateSettling) {
+        line.append_P(PSTR("Next "));
+    }
+    line.append_number(remaining, 6).append_P(PSTR(" ms"));
+    if (_state != StateSettling) {
+        line.append_P(PSTR(" left"));
+    }
+    _display.set_line(1, line.get_text());
+
+    // Only the digits that changed go out to the LCD
+    _display.flush();
+}
@@ -0,0 +1,90 @@
+#ifndef CAPTURE_CONTROLLER_H_
+#define CAPTURE_CONTROLLER_H_
+
+#include <stdint.h>
+
+#include "capture.h"
+#include "capture_timeline.h"
+#include "lcd_framebuffer.h"
+#include "sweep.h"
+
+// Runs captures and sweeps without blocking the main loop.  The main
+// loop calls tick() as often as it can; the relay edges themselves are
+// driven by the CaptureEngine's timer interrupt, so all tick() has to
+// do is notice when a capture has finished, wait out the settle time
+// between sweep shots, and keep the LCD up to date.
+//
+// With the sensor trigger selected in the menu, each capture cues the
+// camera and then waits, armed, for the external trigger instead of
+// starting straight away.
+class CaptureController {
+
+public:
+
+    CaptureController(LcdFrameBuffer &display, CaptureEngine &capture);
+
+    // Queue a capture (or a sweep, if sweeping is turned on) to start
+    // as soon as we're idle.
+    void request_start();
+
+    // Stop whatever is running and put every relay back in its resting
+    // state.
+    void abort();
+
+    // Busy from the moment a start is requested, not just once tick()
+    // gets round to it, so keys that follow a START in the same batch
+    // of events (eg. B to abort) are handled as capture keys.
+    inline bool is_busy() const {
+        return _state != StateIdle || _queued_starts > 0;
+    }
+
+    // Advance the state machine.  Returns true when we've just gone
+    // idle, meaning the display needs redrawing.
+    bool tick();
+
+private:
+
+    enum State {
+        StateIdle,
+        StateArmed,
+        StateCapturing,
+        StateSettling
+    };
+
+    void start_capture();
+    void finish_capture();
+    void refuse_capture(char const *reason);
+    void enter_state(State state, unsigned long length_ms);
+    void show_status(bool force);
+
+    LcdFrameBuffer &_display;
+    CaptureEngine &_capture;
+    CaptureTimeline _timeline;
+
+    Sweep _sweep;
+    bool _sweeping;
+
+    State _state;
+    unsigned long _state_started_ms;
+    unsigned long _state_length_ms;
+    unsigned long _last_status_ms;
+
+    // Set while burst mode is deliberately holding the camera cued
+    // between captures.
+    bool _camera_held_cued;
+
+    // START presses made while busy, still to be served.
+    uint8_t _queued_starts;
+
+    // In StateArmed: whether the engine is waiting for the trigger
+    // yet, or we're still giving the camera its prepare time.  Stays
+    // set through the triggered capture, which leaves the display be.
+    bool _trigger_engine_armed;
+    uint16_t _late_triggers;
+
+    // micros() when the engine was started from the START key, for
+    // timing the first edge afterwards.
+    unsigned long _engine_start_us;
+};
+
+#endif
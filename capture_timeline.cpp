@@ -0,0 +1,47 @@
+#include "capture_timeline.h"
+
+#include <stdint.h>
+
+#include "relays.h"
+
+bool CaptureTimeline::add_relay_edge(unsigned long time_us, uint8_t relay_index, bool close) {
+    Relay &r = relay(relay_index);
+    uint8_t volatile *port = r.get_port();
+    uint8_t mask = r.get_mask();
+    bool set = (close == r.close_sets_bit());
+
+    // Find the insertion point, merging with an existing event for
+    // the same port and time if there is one.
+    uint8_t i = 0;
+    while (i < _num_events && _events[i].time_us <= time_us) {
+        CaptureEvent &e = _events[i];
+        if (e.time_us == time_us && e.port == port) {
+            if (set) {
+                e.set_mask |= mask;
+                e.clear_mask &= ~mask;
+            } else {
+                e.clear_mask |= mask;
+                e.set_mask &= ~mask;
+            }
+            return true;
+        }
+        i++;
+    }
+
+    if (_num_events >= MaxEvents) {
+        return false;
+    }
+
+    for (uint8_t j = _num_events; j > i; j--) {
+        _events[j] = _events[j - 1];
+    }
+
+    CaptureEvent &e = _events[i];
+    e.time_us = time_us;
+    e.port = port;
+    e.set_mask = set ? mask : 0;
+    e.clear_mask = set ? 0 : mask;
+    _num_events++;
+
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef CAPTURE_TIMELINE_H_
+#define CAPTURE_TIMELINE_H_
+
+#include <stdint.h>
+
+// One instant in a capture: a single write to one output port that
+// sets and clears the given bits.  Every relay edge on the same port
+// at the same time is folded into one event, so those relays switch
+// on the same instruction.
+struct CaptureEvent {
+    unsigned long time_us;
+    uint8_t volatile *port;
+    uint8_t set_mask;
+    uint8_t clear_mask;
+};
+
+// A capture sequence compiled ahead of time into a sorted list of
+// port writes, ready to be replayed by CaptureEngine without any
+// per-edge computation.
+class CaptureTimeline {
+
+public:
+
+    static uint8_t const MaxEvents = 12;
+
+    CaptureTimeline() : _num_events(0) {}
+
+    void clear() {
+        _num_events = 0;
+    }
+
+    // Add a relay edge at the given time (in microseconds from the
+    // start of the capture).  Edges may be added in any order; an
+    // edge on a pin that already has one at the same time replaces
+    // it.  Returns false if the timeline is full.
+    bool add_relay_edge(unsigned long time_us, uint8_t relay_index, bool close);
+
+    inline uint8_t get_num_events() const {
+        return _num_events;
+    }
+
+    inline CaptureEvent const &get_event(uint8_t index) const {
+        return _events[index];
+    }
+
+    // Time of the last event, ie. the length of the capture.
+    inline unsigned long get_duration_us() const {
+        return _num_events ? _events[_num_events - 1].time_us : 0;
+    }
+
+private:
+
+    CaptureEvent _events[MaxEvents];
+    uint8_t _num_events;
+};
+
+#endif
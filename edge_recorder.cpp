@@ -0,0 +1,119 @@
+#include "edge_recorder.h"
+
+#include <stdint.h>
+
+#include "constants.h"
+#include "printf.h"
+#include "relays.h"
+
+static uint8_t const Edge_recorder_captures = 4;
+
+struct RecordedEdge {
+    unsigned long setpoint_us;
+    uint8_t volatile *port;
+    uint8_t set_mask;
+    uint8_t clear_mask;
+    int16_t error_ticks;
+};
+
+struct RecordedCapture {
+    uint16_t number;
+    uint8_t num_edges;
+    bool complete;
+    RecordedEdge edges[CaptureTimeline::MaxEvents];
+};
+
+static RecordedCapture edge_captures[Edge_recorder_captures];
+static uint8_t edge_next = 0;
+static uint8_t edge_count = 0;
+static uint16_t edge_capture_number = 0;
+
+static char const *relay_name(uint8_t index) {
+    if (index == RelayIndexValve) {
+        return "valve";
+    } else if (index == RelayIndexCueShutter) {
+        return "cue";
+    } else if (index == RelayIndexReleaseShutter) {
+        return "release";
+    }
+    return "?";
+}
+
+// Print a tick count as microseconds, with the fraction.
+static void print_ticks_us(unsigned long ticks) {
+    dprintf("%lu.%u",
+            ticks / CaptureTicksPerMicro,
+            (unsigned int)(ticks % CaptureTicksPerMicro) * 10 / CaptureTicksPerMicro);
+}
+
+void edge_recorder_add(CaptureTimeline const &timeline, CaptureEngine const &capture) {
+    RecordedCapture &record = edge_captures[edge_next];
+
+    record.number = ++edge_capture_number;
+    record.num_edges = capture.get_num_edges_done();
+    record.complete = (record.num_edges == timeline.get_num_events());
+
+    for (uint8_t i = 0; i < record.num_edges; i++) {
+        CaptureEvent const &event = timeline.get_event(i);
+        RecordedEdge &edge = record.edges[i];
+
+        edge.setpoint_us = event.time_us;
+        edge.port = event.port;
+        edge.set_mask = event.set_mask;
+        edge.clear_mask = event.clear_mask;
+        edge.error_ticks = capture.get_edge_error_ticks(i);
+    }
+
+    edge_next = (edge_next + 1) % Edge_recorder_captures;
+    if (edge_count < Edge_recorder_captures) {
+        edge_count++;
+    }
+}
+
+void edge_recorder_dump() {
+    if (edge_count == 0) {
+        dprintf("No captures recorded\n");
+        return;
+    }
+
+    uint8_t slot = (edge_next + Edge_recorder_captures - edge_count) % Edge_recorder_captures;
+
+    for (uint8_t n = 0; n < edge_count; n++) {
+        RecordedCapture const &record = edge_captures[slot];
+        slot = (slot + 1) % Edge_recorder_captures;
+
+        dprintf("Capture %u%s: edge, setpoint / actual / error (us)\n",
+                record.number,
+                record.complete ? "" : " (aborted)");
+
+        for (uint8_t i = 0; i < record.num_edges; i++) {
+            RecordedEdge const &edge = record.edges[i];
+
+            // One event can switch several relays on the same port;
+            // list each of them.
+            for (uint8_t r = 0; r < get_num_relays(); r++) {
+                Relay &rl = relay(r);
+                uint8_t mask = rl.get_mask();
+
+                if (rl.get_port() != edge.port || !((edge.set_mask | edge.clear_mask) & mask)) {
+                    continue;
+                }
+
+                bool closed = (bool)(edge.set_mask & mask) == rl.close_sets_bit();
+
+                dprintf("  %s %s: %lu / ",
+                        relay_name(r), closed ? "on" : "off", edge.setpoint_us);
+                print_ticks_us(edge.setpoint_us * CaptureTicksPerMicro + edge.error_ticks);
+
+                if (edge.error_ticks < 0) {
+                    dprintf(" / -");
+                    print_ticks_us(-edge.error_ticks);
+                } else {
+                    dprintf(" / +");
+                    print_ticks_us(edge.error_ticks);
+                }
+                dprintf("\n");
+            }
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef EDGE_RECORDER_H_
+#define EDGE_RECORDER_H_
+
+#include <stdint.h>
+
+#include "capture.h"
+#include "capture_timeline.h"
+
+/*
+ * Keeps the relay edge timings of the last few captures: where each
+ * edge was supposed to be in the timeline, and where the capture
+ * engine's Timer5 timestamp says it actually was.  The report goes out
+ * over serial, to make timing regressions easy to spot.
+ */
+
+// Copy the edges of a capture that has just finished (or been
+// aborted) into the ring, replacing the oldest one if it's full.  The
+// timeline must be the one the engine just ran.
+void edge_recorder_add(CaptureTimeline const &timeline, CaptureEngine const &capture);
+
+// Print setpoint, actual time and error for every recorded edge,
+// oldest capture first.
+void edge_recorder_dump();
+
+#endif
@@ -5,14 +5,36 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
 #include <avr/sleep.h>
+#include <util/atomic.h>
+#include <util/delay.h>
 
 #include "Arduino.h"
 
+#include "printf.h"
+
 static Joypad *volatile joypad_instance = NULL;
 
 static uint16_t const Joypad_clk_len = 0x2;
 static uint16_t const Joypad_read_delay = 0x8;
 
+// Timer3 ticks (clkIO/1024) between burst reads
+static uint16_t const Joypad_poll_ticks = F_CPU / 1024 / JOYPAD_POLL_HZ;
+
+// Direction keys: up, down, left, right
+static uint16_t const Joypad_default_repeat_keys = (1 << 4) | (1 << 5) | (1 << 6) | (1 << 7);
+
+static KeyRepeat const Joypad_default_repeat = {
+    400,    // delay_ms
+    150,    // interval_ms
+    20,     // min_interval_ms
+    15      // accel_percent
+};
+
+// Burst read timing.  The pad's 4021 shift registers are happy with
+// much shorter pulses than the 12us latch / 6us clock a console uses.
+static double const Joypad_burst_latch_us = 2;
+static double const Joypad_burst_half_clock_us = 1;
+
 static inline void enable_timer3_interrupt() {
     TIMSK3 |= _BV(OCIE3A);
 }
@@ -53,13 +75,33 @@ static void setup_timer3() {
     OCR3A = 0xffff;
 }
 
+// Stop the compiler from moving memory accesses across this point, so
+// a queue slot is completely written (or read) before the index that
+// hands it over is updated.
+static inline void memory_barrier() {
+    __asm__ __volatile__ ("" ::: "memory");
+}
+
 //
 // Joypad class implementation
 //
 
-Joypad::Joypad() : input_ready(false), input_value(0), input_presses(0) {
+Joypad::Joypad() : input_ready(false),
+                   input_value(0),
+                   _event_head(0),
+                   _event_tail(0),
+                   _events_dropped(0),
+                   _last_keystate(0),
+                   _repeat_keys(Joypad_default_repeat_keys),
+                   _repeat(Joypad_default_repeat),
+                   _repeating(false),
+                   _repeat_key(0),
+                   _held_keys(0),
+                   _repeat_drops_seen(0),
+                   _repeat_due_us(0),
+                   _repeat_interval_ms(0) {
     if (joypad_instance) {
-        printf("Attempt to initialize a joypad instance when one exists");
+        dprintf("Attempt to initialize a joypad instance when one exists\n");
         return;
     }
     
@@ -85,11 +127,99 @@ Joypad::~Joypad() {
     joypad_instance = NULL;
 }
 
-KeyState const Joypad::get_pressed() {
-    uint16_t presses = input_presses;
-    input_presses = 0;
-    
-    return KeyState(presses);
+bool Joypad::next_event(KeyEvent &event) {
+    // A dropped event could have been the repeating key's release, so
+    // stop repeating rather than risk repeating forever
+    uint16_t dropped;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        dropped = _events_dropped;
+    }
+    if (dropped != _repeat_drops_seen) {
+        _repeat_drops_seen = dropped;
+        _repeating = false;
+    }
+
+    uint8_t tail = _event_tail;
+    if (tail == _event_head) {
+        return next_repeat(event);
+    }
+
+    memory_barrier();
+    event = _events[tail];
+    memory_barrier();
+
+    _event_tail = (tail + 1) & (EventQueueSize - 1);
+
+    track_repeat(event);
+    return true;
+}
+
+void Joypad::set_repeat(uint16_t keys, KeyRepeat const &timing) {
+    _repeat_keys = keys;
+    _repeat = timing;
+    _repeating = false;
+}
+
+// The most recently pressed repeatable key is the one that repeats;
+// releasing it stops the repeat, but pressing or releasing other keys
+// (like the A/B step modifiers) doesn't.  The release is judged from
+// the held keys rather than the key-up event itself, in case that
+// event was one the full queue dropped.
+void Joypad::track_repeat(KeyEvent const &event) {
+    _held_keys = event.held;
+
+    if (_repeating && !(event.held & (1 << _repeat_key))) {
+        _repeating = false;
+    }
+
+    if (event.down) {
+        if (_repeat_keys & (1 << event.key)) {
+            _repeating = true;
+            _repeat_key = event.key;
+            _repeat_due_us = event.time_us + _repeat.delay_ms * 1000UL;
+            _repeat_interval_ms = _repeat.interval_ms;
+        }
+    }
+}
+
+bool Joypad::next_repeat(KeyEvent &event) {
+    if (!_repeating) {
+        return false;
+    }
+
+    unsigned long now_us = micros();
+    if ((long)(now_us - _repeat_due_us) < 0) {
+        return false;
+    }
+
+    // The queue is empty, so the pad's current state is the latest
+    // word on what's held
+    uint16_t held;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        held = input_value;
+    }
+
+    if (!(held & (1 << _repeat_key))) {
+        _repeating = false;
+        return false;
+    }
+    _held_keys = held;
+
+    event.key = _repeat_key;
+    event.down = true;
+    event.repeat = true;
+    event.held = _held_keys;
+    event.time_us = now_us;
+
+    // Schedule from now rather than from the due time, so a main loop
+    // that was busy for a while doesn't get a burst of catch-up
+    // repeats.
+    _repeat_due_us = now_us + _repeat_interval_ms * 1000UL;
+
+    uint16_t faster = _repeat_interval_ms - (uint32_t)_repeat_interval_ms * _repeat.accel_percent / 100;
+    _repeat_interval_ms = faster > _repeat.min_interval_ms ? faster : _repeat.min_interval_ms;
+
+    return true;
 }
 
 KeyState const Joypad::get_held() {
@@ -97,13 +227,85 @@ KeyState const Joypad::get_held() {
 }
 
 void Joypad::start_listening() {
+#ifdef JOYPAD_BURST_READ
+    reset_timer3(Joypad_poll_ticks);
+#else
     reset_timer3(Joypad_read_delay);
+#endif
 }
 
 void Joypad::stop_listening() {
     disable_timer3_interrupt();
 }
 
+// Publish a complete 16-bit read of the pad, queueing an event for
+// every key that changed since the last one.
+void Joypad::handle_read(uint16_t keystate) {
+    input_value = keystate;
+    input_ready = true;
+
+    uint16_t changed = keystate ^ _last_keystate;
+    _last_keystate = keystate;
+
+    if (!changed) {
+        return;
+    }
+
+    unsigned long now_us = micros();
+
+    for (uint8_t key = 0; key < 16; key++) {
+        if (!(changed & (1 << key))) {
+            continue;
+        }
+
+        uint8_t head = _event_head;
+        uint8_t next = (head + 1) & (EventQueueSize - 1);
+        if (next == _event_tail) {
+            _events_dropped++;
+            continue;
+        }
+
+        KeyEvent &event = _events[head];
+        event.key = key;
+        event.down = keystate & (1 << key);
+        event.repeat = false;
+        event.held = keystate;
+        event.time_us = now_us;
+
+        memory_barrier();
+        _event_head = next;
+    }
+}
+
+#ifdef JOYPAD_BURST_READ
+
+// Timer3 runs in CTC mode at the poll rate, so there is nothing to
+// reprogram here: latch, clock out all 16 bits, done.  The whole burst
+// takes about 40us.  Interrupts are re-enabled straight away, so the
+// capture engine's compare interrupt can cut in; stretching a clock
+// pulse doesn't bother the pad.
+ISR(TIMER3_COMPA_vect, ISR_NOBLOCK) {
+    Joypad *jp = joypad_instance;
+    uint16_t keystate = 0;
+
+    jp->lat(true);
+    _delay_us(Joypad_burst_latch_us);
+    jp->lat(false);
+    _delay_us(Joypad_burst_half_clock_us);
+
+    for (uint8_t bit = 0; bit < 16; bit++) {
+        jp->clk(true);
+        _delay_us(Joypad_burst_half_clock_us);
+        keystate |= (uint16_t)jp->read() << bit;
+        jp->clk(false);
+        _delay_us(Joypad_burst_half_clock_us);
+    }
+
+    jp->handle_read(keystate);
+}
+
+#else
+
 ISR(TIMER3_COMPA_vect) {
     // We track the next operation using this 'step' variable.  We
     // need to strobe the latch line, then toggle the clock while
@@ -113,7 +315,6 @@ ISR(TIMER3_COMPA_vect) {
     
     // Stores the key state while we shift it in from the joypad.  After reading the last bit, we drop
     static uint16_t keystate = 0;
-    static uint16_t laststate = 0;
     
     if (step == 0) {
         // begin read with latch strobe
@@ -134,12 +335,7 @@ ISR(TIMER3_COMPA_vect) {
             
             if (step == 33) {
                 // last bit read; update global state
-                joypad_instance->input_value = keystate;
-                joypad_instance->input_ready = true;
-                
-                uint16_t new_keypresses = keystate & ~laststate;
-                laststate = keystate;
-                joypad_instance->input_presses |= new_keypresses;
+                joypad_instance->handle_read(keystate);
             }
         }
     }
@@ -153,3 +349,5 @@ ISR(TIMER3_COMPA_vect) {
         reset_timer3(Joypad_clk_len);
     }
 };
+
+#endif
@@ -7,6 +7,16 @@
 #include <avr/io.h>
 #include <avr/sleep.h>
 
+// Read all 16 bits from the pad in one burst, JOYPAD_POLL_HZ times a
+// second, instead of spreading each read over 34 timer interrupts (one
+// per half clock).  Comment this out to go back to the spread-out
+// reader.
+#define JOYPAD_BURST_READ
+
+#ifndef JOYPAD_POLL_HZ
+#define JOYPAD_POLL_HZ 100
+#endif
+
 class KeyState {
 
 public:
@@ -31,7 +41,34 @@ public:
     inline bool key_r() const { return _keyvalue & (1 << 11); }
 };
 
+// One key going down or up, as seen by a single poll of the joypad,
+// or an auto-repeat of a key that is being held.
+struct KeyEvent {
+    uint8_t key;            // bit number, as used by KeyState
+    bool down;              // true when pressed, false when released
+    bool repeat;            // synthesized while the key is held down
+    uint16_t held;          // every key held as of this event
+    unsigned long time_us;  // micros() when the poll saw the change
+
+    inline KeyState get_key() const {
+        return KeyState(1 << key);
+    }
+
+    inline KeyState get_held() const {
+        return KeyState(held);
+    }
+};
+
 
+// Auto-repeat timing.  After a key has been held for delay_ms it
+// repeats every interval_ms, and each repeat after that comes
+// accel_percent sooner than the one before, down to min_interval_ms.
+struct KeyRepeat {
+    uint16_t delay_ms;
+    uint16_t interval_ms;
+    uint16_t min_interval_ms;
+    uint8_t accel_percent;
+};
 
 class Joypad {
 
@@ -43,14 +80,33 @@ public:
     void start_listening();
     void stop_listening();
 
-    // Return newly pressed keys and clear the list of "newly pressed
-    // keys"; ie. the next call will return no keys pressed unless one
-    // was released (if necessary) and pressed again.
-    KeyState const get_pressed();
+    // Take the oldest key event off the queue, or make a repeat event
+    // if a repeating key has been held long enough.  Returns false if
+    // there is nothing to report.  Only the main loop may call this.
+    bool next_event(KeyEvent &event);
+
+    // Whether the interrupt has queued events the main loop hasn't
+    // taken yet.  Doesn't count pending auto-repeats.
+    inline bool has_events() const {
+        return _event_tail != _event_head;
+    }
+
+    // Set which keys auto-repeat (a KeyState-style bit mask) and how
+    // fast.  By default only the direction keys repeat.
+    void set_repeat(uint16_t keys, KeyRepeat const &timing);
 
     // Return keys currently being held down.
     KeyState const get_held();
 
+    // Number of key events thrown away because the queue was full.
+    inline uint16_t get_events_dropped() const {
+        return _events_dropped;
+    }
+
+    // Called from the timer3 interrupt with each complete read of the
+    // pad.
+    void handle_read(uint16_t keystate);
+
     // Set joypad latch value.
     inline void lat(bool activate) {
         if (activate) {
@@ -76,8 +132,36 @@ public:
 
     volatile bool input_ready;
     volatile uint16_t input_value;
-    volatile uint16_t input_presses;
 
+private:
+
+    // Must be a power of two.
+    static uint8_t const EventQueueSize = 16;
+
+    // Single-producer, single-consumer ring: the interrupt only
+    // writes _event_head and the main loop only writes _event_tail,
+    // so neither side has to disable interrupts.
+    KeyEvent _events[EventQueueSize];
+    volatile uint8_t _event_head;
+    volatile uint8_t _event_tail;
+    volatile uint16_t _events_dropped;
+
+    uint16_t _last_keystate;
+
+    // Auto-repeat is generated on the consumer side, from the events
+    // the main loop has already taken off the queue.
+    void track_repeat(KeyEvent const &event);
+    bool next_repeat(KeyEvent &event);
+
+    uint16_t _repeat_keys;
+    KeyRepeat _repeat;
+
+    bool _repeating;
+    uint8_t _repeat_key;
+    uint16_t _held_keys;
+    uint16_t _repeat_drops_seen;
+    unsigned long _repeat_due_us;
+    uint16_t _repeat_interval_ms;
 };
 
 #endif
@@ -0,0 +1,137 @@
+#include "latency.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <util/atomic.h>
+
+#include "Arduino.h"
+
+#include "printf.h"
+
+// Bucket 0 holds 0-1 us; bucket n holds 2^n up to 2^(n+1) - 1 us; the
+// last bucket also takes everything longer.
+static uint8_t const Latency_buckets = 20;
+
+struct LatencyStats {
+    uint16_t count;
+    unsigned long min_us;
+    unsigned long max_us;
+    unsigned long total_us;
+    uint16_t buckets[Latency_buckets];
+};
+
+static char const *const latency_stage_names[LatencyStageCount] = {
+    "key->loop",
+    "key->capture",
+    "key->engine",
+    "key->edge",
+    "edge late"
+};
+
+static LatencyStats latency_stats[LatencyStageCount];
+
+static volatile bool latency_tracing = false;
+static volatile unsigned long latency_origin_us = 0;
+
+static uint8_t latency_bucket(unsigned long us) {
+    uint8_t bucket = 0;
+
+    while (us > 1 && bucket < Latency_buckets - 1) {
+        us >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+void latency_begin(unsigned long origin_us) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        latency_origin_us = origin_us;
+        latency_tracing = true;
+    }
+}
+
+void latency_mark(uint8_t stage) {
+    if (!latency_tracing) {
+        return;
+    }
+
+    latency_mark_at(stage, micros());
+}
+
+void latency_mark_at(uint8_t stage, unsigned long time_us) {
+    if (!latency_tracing) {
+        return;
+    }
+
+    latency_record(stage, time_us - latency_origin_us);
+}
+
+void latency_end() {
+    latency_tracing = false;
+}
+
+void latency_record(uint8_t stage, unsigned long us) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        LatencyStats &stats = latency_stats[stage];
+
+        // Stop counting rather than wrap
+        if (stats.count < 0xffff) {
+            if (stats.count == 0 || us < stats.min_us) {
+                stats.min_us = us;
+            }
+            if (us > stats.max_us) {
+                stats.max_us = us;
+            }
+
+            stats.count++;
+            stats.total_us += us;
+            stats.buckets[latency_bucket(us)]++;
+        }
+    }
+}
+
+void latency_reset() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        memset(latency_stats, 0, sizeof(latency_stats));
+        latency_tracing = false;
+    }
+}
+
+void latency_dump() {
+    dprintf("Latency: count min/avg/max in ms, then counts by us\n");
+
+    for (uint8_t stage = 0; stage < LatencyStageCount; stage++) {
+        // Copy, since edges keep being recorded from the capture
+        // interrupt while we print
+        LatencyStats stats;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            stats = latency_stats[stage];
+        }
+
+        if (stats.count == 0) {
+            dprintf("%s: none\n", latency_stage_names[stage]);
+            continue;
+        }
+
+        dprintf("%s: %u %k/%k/%k\n",
+                latency_stage_names[stage],
+                stats.count,
+                stats.min_us,
+                stats.total_us / stats.count,
+                stats.max_us);
+
+        for (uint8_t bucket = 0; bucket < Latency_buckets; bucket++) {
+            if (stats.buckets[bucket] == 0) {
+                continue;
+            }
+
+            if (bucket == Latency_buckets - 1) {
+                dprintf("  >=%lu: %u\n", 1UL << bucket, stats.buckets[bucket]);
+            } else {
+                dprintf("  <%lu: %u\n", 1UL << (bucket + 1), stats.buckets[bucket]);
+            }
+        }
+    }
+}
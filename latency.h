@@ -0,0 +1,54 @@
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+
+/*
+ * Latency tracing from a key press to the relays switching.
+ *
+ * A trace starts at the time the joypad interrupt saw the START key
+ * go down, and each stage after that records how long it's been since
+ * then.  Every stage keeps a min/avg/max and a histogram with
+ * power-of-two buckets, which latency_dump() prints over serial.
+ *
+ * LatencyKeyDispatch is recorded for every key press, and
+ * LatencyEdgeLate for every relay edge of every capture, trace or not.
+ * The edge stages are filled in from the recorded edge times after a
+ * capture finishes, never from the capture interrupt.
+ */
+
+enum LatencyStage {
+    LatencyKeyDispatch,     // joypad interrupt -> main loop
+    LatencyCaptureStart,    // START -> CaptureController::start_capture
+    LatencyEngineStart,     // START -> CaptureEngine::start, after the LCD has caught up
+    LatencyFirstEdge,       // START -> first relay edge
+    LatencyEdgeLate,        // setpoint -> port write, for each edge
+    LatencyStageCount
+};
+
+// Start a trace from a key seen at origin_us (a micros() value).
+void latency_begin(unsigned long origin_us);
+
+// Record the time since the start of the current trace against a
+// stage.  Does nothing if no trace is running.  Safe to call from an
+// interrupt.
+void latency_mark(uint8_t stage);
+
+// The same, for something that happened at time_us (a micros()
+// value) rather than now.
+void latency_mark_at(uint8_t stage, unsigned long time_us);
+
+// Finish the current trace; later marks are ignored until the next
+// latency_begin().
+void latency_end();
+
+// Record a time directly.  Safe to call from an interrupt.
+void latency_record(uint8_t stage, unsigned long us);
+
+// Forget everything recorded so far.
+void latency_reset();
+
+// Print every stage with dprintf.
+void latency_dump();
+
+#endif
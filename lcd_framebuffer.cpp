@@ -0,0 +1,88 @@
+#include "lcd_framebuffer.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// What a full redraw costs: a cursor move and a full row of
+// characters for each row.
+static unsigned int const Lcd_full_redraw_bytes = LcdFrameBuffer::Rows * (1 + LcdFrameBuffer::Cols);
+
+//
+// LcdFrameBuffer class implementation
+//
+
+LcdFrameBuffer::LcdFrameBuffer(LiquidCrystal_I2C &lcd)
+    : _lcd(lcd), _shadow_valid(true), _bytes_saved(0) {
+    memset(_pending, ' ', sizeof(_pending));
+    memset(_shadow, ' ', sizeof(_shadow));
+}
+
+void LcdFrameBuffer::set_line(uint8_t row, char const *text) {
+    if (row >= Rows) {
+        return;
+    }
+
+    char *cell = _pending[row];
+    uint8_t col = 0;
+
+    while (col < Cols && text[col]) {
+        cell[col] = text[col];
+        col++;
+    }
+
+    while (col < Cols) {
+        cell[col++] = ' ';
+    }
+}
+
+void LcdFrameBuffer::clear() {
+    memset(_pending, ' ', sizeof(_pending));
+}
+
+void LcdFrameBuffer::invalidate() {
+    _shadow_valid = false;
+}
+
+void LcdFrameBuffer::flush() {
+    unsigned int bytes_sent = 0;
+
+    for (uint8_t row = 0; row < Rows; row++) {
+        // Column the display's cursor is at after our last write, or
+        // Cols if we haven't written to this row yet.  The cursor
+        // doesn't wrap from the end of one row to the start of the
+        // next, so we track it per row.
+        uint8_t cursor_col = Cols;
+        uint8_t col = 0;
+
+        while (col < Cols) {
+            if (_shadow_valid && _shadow[row][col] == _pending[row][col]) {
+                col++;
+                continue;
+            }
+
+            // Gather the whole run of changed cells, so it can go out
+            // in as few I2C transactions as possible.
+            uint8_t start = col;
+            do {
+                _shadow[row][col] = _pending[row][col];
+                col++;
+            } while (col < Cols && !(_shadow_valid && _shadow[row][col] == _pending[row][col]));
+
+            if (cursor_col != start) {
+                _lcd.setCursor(start, row);
+                bytes_sent++;
+            }
+
+            _lcd.write((uint8_t const *)&_pending[row][start], col - start);
+            bytes_sent += col - start;
+
+            cursor_col = col;
+        }
+    }
+
+    _shadow_valid = true;
+
+    if (bytes_sent < Lcd_full_redraw_bytes) {
+        _bytes_saved += Lcd_full_redraw_bytes - bytes_sent;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef LCD_FRAMEBUFFER_H_
+#define LCD_FRAMEBUFFER_H_
+
+#include <stdint.h>
+
+#include "LiquidCrystal_I2C.h"
+
+// A shadow copy of the LCD contents.  Text is drawn into the
+// framebuffer, and flush() sends only the cells that differ from what
+// is already on the glass, moving the cursor only when the next
+// changed cell isn't where the display's auto-increment left it.
+//
+// Everything that draws on the LCD should go through here; if
+// something writes to the LCD directly, call invalidate() so the next
+// flush() rewrites every cell.
+class LcdFrameBuffer {
+
+public:
+
+    static uint8_t const Rows = 2;
+    static uint8_t const Cols = 16;
+
+    // The display is assumed to have just been cleared.
+    LcdFrameBuffer(LiquidCrystal_I2C &lcd);
+
+    // Replace a whole row, space-padding (or truncating) the text to
+    // the width of the display.
+    void set_line(uint8_t row, char const *text);
+
+    // Blank the framebuffer.  Like everything else, this only reaches
+    // the display on flush().
+    void clear();
+
+    // Send the changed cells to the display.  This only queues them;
+    // they go out over I2C from the TWI interrupt.
+    void flush();
+
+    // Wait until everything flushed so far is actually on the display.
+    // Use before timing-critical work, so that the TWI interrupt isn't
+    // busy in the middle of it.
+    void wait_until_displayed() {
+        _lcd.flush();
+    }
+
+    // Forget what's on the glass, so the next flush() sends everything.
+    void invalidate();
+
+    // Bytes (characters plus cursor moves) that a full redraw would
+    // have sent but we didn't, since startup.
+    inline unsigned long get_bytes_saved() const {
+        return _bytes_saved;
+    }
+
+private:
+
+    LiquidCrystal_I2C &_lcd;
+
+    char _pending[Rows][Cols];
+    char _shadow[Rows][Cols];
+    bool _shadow_valid;
+
+    unsigned long _bytes_saved;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "lcd_line.h"
+
+#include <stdint.h>
+
+#include "printf.h"
+
+//
+// LcdLine class implementation
+//
+
+LcdLine &LcdLine::append(char c) {
+    if (_length < Cols) {
+        _text[_length++] = c;
+        _text[_length] = '\0';
+    }
+    return *this;
+}
+
+LcdLine &LcdLine::append(char const *text) {
+    while (*text && _length < Cols) {
+        _text[_length++] = *text++;
+    }
+    _text[_length] = '\0';
+    return *this;
+}
+
+LcdLine &LcdLine::append_P(char const *text) {
+    char c;
+    while (_length < Cols && (c = pgm_read_byte(text++))) {
+        _text[_length++] = c;
+    }
+    _text[_length] = '\0';
+    return *this;
+}
+
+LcdLine &LcdLine::append_number(unsigned long value, uint8_t width) {
+    // Same conversion as printf, without the format parsing
+    char digits[11];
+    tfp_ultoa(value, digits);
+
+    uint8_t len = 0;
+    while (digits[len]) {
+        len++;
+    }
+
+    if (width > len) {
+        pad_to(_length + width - len);
+    }
+    return append(digits);
+}
+
+LcdLine &LcdLine::pad_to(uint8_t col) {
+    while (_length < col && _length < Cols) {
+        _text[_length++] = ' ';
+    }
+    _text[_length] = '\0';
+    return *this;
+}
@@ -0,0 +1,60 @@
+#ifndef LCD_LINE_H_
+#define LCD_LINE_H_
+
+#include <stdint.h>
+
+#include <avr/pgmspace.h>
+
+#include "lcd_framebuffer.h"
+
+// One row of LCD text, built up a piece at a time without going
+// through printf.  Anything past the width of the display is dropped,
+// so pieces can be appended without checking for room.
+//
+//     LcdLine line;
+//     line.append("Next ").append_number(remaining, 6).append(" ms");
+//     display.set_line(1, line.get_text());
+class LcdLine {
+
+public:
+
+    static uint8_t const Cols = LcdFrameBuffer::Cols;
+
+    LcdLine() {
+        clear();
+    }
+
+    void clear() {
+        _length = 0;
+        _text[0] = '\0';
+    }
+
+    LcdLine &append(char c);
+    LcdLine &append(char const *text);
+
+    // Append a string that's in program memory (eg. from PSTR()),
+    // straight from flash.
+    LcdLine &append_P(char const *text);
+
+    // Append value in decimal, right-aligned in a field of width
+    // columns (or just as wide as it needs with 0).
+    LcdLine &append_number(unsigned long value, uint8_t width=0);
+
+    // Append spaces up to column col.
+    LcdLine &pad_to(uint8_t col);
+
+    char const *get_text() const {
+        return _text;
+    }
+
+    uint8_t get_length() const {
+        return _length;
+    }
+
+private:
+
+    char _text[Cols + 1];
+    uint8_t _length;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "log.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include <avr/pgmspace.h>
+
+#include "printf.h"
+#include "uart.h"
+
+#ifdef LOG_BINARY
+
+// Longest record: the marker and up to this many argument bytes.  The
+// decoder checks the table against it.
+static uint8_t const Log_max_arg_bytes = 15;
+
+#define LOG_FORMAT(name, args, format) static char const log_args_##name[] PROGMEM = args;
+LOG_FORMATS
+#undef LOG_FORMAT
+
+static char const *const log_args[] PROGMEM = {
+#define LOG_FORMAT(name, args, format) log_args_##name,
+    LOG_FORMATS
+#undef LOG_FORMAT
+};
+
+void log_event(uint8_t id, ...) {
+    uint8_t record[1 + Log_max_arg_bytes];
+    uint8_t len = 0;
+
+    record[len++] = LOG_RECORD_MARKER + id;
+
+    va_list va;
+    va_start(va, id);
+
+    char const *args = (char const *)pgm_read_ptr(&log_args[id]);
+    char size;
+    while ((size = pgm_read_byte(args++)) && len <= sizeof(record) - 4) {
+        if (size == '4') {
+            unsigned long value = va_arg(va, unsigned long);
+            record[len++] = value;
+            record[len++] = value >> 8;
+            record[len++] = value >> 16;
+            record[len++] = value >> 24;
+        } else {
+            unsigned int value = va_arg(va, unsigned int);
+            record[len++] = value;
+            if (size == '2') {
+                record[len++] = value >> 8;
+            }
+        }
+    }
+
+    va_end(va);
+
+    // All or nothing, so a full buffer can't leave half a record in
+    // the stream
+    uart_write(record, len);
+}
+
+#else
+
+static char const *const log_formats[] = {
+#define LOG_FORMAT(name, args, format) format,
+    LOG_FORMATS
+#undef LOG_FORMAT
+};
+
+void log_event(uint8_t id, ...) {
+    va_list va;
+    va_start(va, id);
+    tfp_vprintf(log_formats[id], va);
+    va_end(va);
+}
+
+#endif
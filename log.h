@@ -0,0 +1,42 @@
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <stdint.h>
+
+#include "log_formats.h"
+
+/*
+ * Logging of the messages in log_formats.h.
+ *
+ * In text mode (the default) log_event() is just printf with the
+ * message's format.  With LOG_BINARY defined, it skips formatting on
+ * the AVR altogether and sends a compact record instead: one byte of
+ * 0x80 + the message number, then the arguments as raw little-endian
+ * bytes.  Plain text (dprintf) is 7-bit, so the two can share the
+ * serial line; tools/log_decode.cpp turns the stream back into text.
+ *
+ * log_trace() is for messages that are only worth having in binary
+ * mode, like one for every key event; in text mode it compiles away.
+ */
+
+// #define LOG_BINARY
+
+enum LogId {
+#define LOG_FORMAT(name, args, format) name,
+    LOG_FORMATS
+#undef LOG_FORMAT
+    LogIdCount
+};
+
+// The record marker; message numbers have to fit under it.
+#define LOG_RECORD_MARKER 0x80
+
+void log_event(uint8_t id, ...);
+
+#ifdef LOG_BINARY
+#define log_trace log_event
+#else
+#define log_trace(...)
+#endif
+
+#endif
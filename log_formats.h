@@ -0,0 +1,39 @@
+#ifndef LOG_FORMATS_H_
+#define LOG_FORMATS_H_
+
+/*
+ * Every message that goes through log_event(), in one table shared by
+ * the firmware and the host decoder (tools/log_decode.cpp).  Only add
+ * to the end: in binary mode, a record is identified by its position
+ * in this table.
+ *
+ *     LOG_FORMAT(name, args, format)
+ *
+ * args has one character per argument, giving how many bytes it takes
+ * in a binary record:
+ *
+ *     '1'  a char or small int (%c, or %u/%d/%x of something < 256)
+ *     '2'  an int (%u, %d, %x)
+ *     '4'  a long (%lu, %ld, %lx, %k)
+ *
+ * Strings (%s) can't be logged this way.  The decoder checks args
+ * against format when it starts.
+ *
+ * Only the preprocessor sees this file, so it's plain enough for the
+ * host compiler too.
+ */
+
+#define LOG_FORMATS \
+    LOG_FORMAT(LogCaptureAborted, "",     "Capture aborted\n") \
+    LOG_FORMAT(LogCaptureDone,    "22",   "Capture done; worst edge jitter %u.%u us\n") \
+    LOG_FORMAT(LogCaptureEdge,    "14112", "  edge %u at %lu us: set %x clear %x, %d ticks late\n") \
+    LOG_FORMAT(LogTimelineFull,   "",     "Capture sequence doesn't fit in the timeline\n") \
+    LOG_FORMAT(LogTriggerLate,    "",     "Trigger was serviced late; capture started without the fixed lead\n") \
+    LOG_FORMAT(LogSweepStart,     "24",   "Sweep: %u shots, %lu ms apart\n") \
+    LOG_FORMAT(LogSweepShot,      "2244", "Sweep shot %u/%u: valve open %lu ms, shutter %lu ms\n") \
+    LOG_FORMAT(LogSweepDone,      "",     "Sweep done\n") \
+    LOG_FORMAT(LogKeyEvent,       "114",  "Key %u %c at %lu us\n") \
+    LOG_FORMAT(LogSettingsSaved,  "1",    "Settings saved to slot %u\n") \
+    LOG_FORMAT(LogShutterRefOff,  "",     "Shutter reference drop is turned off\n")
+
+#endif
@@ -2,11 +2,14 @@
 #define MENU_H_
 
 #include <stdint.h>
+#include <string.h>
 
-#include "LiquidCrystal_I2C.h"
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
 
 #include "joypad.h"
-#include "printf.h"
+#include "lcd_framebuffer.h"
+#include "lcd_line.h"
 
 typedef uint16_t MenuId;
 
@@ -16,8 +19,10 @@ class MenuItem {
 
 public:
 
-    virtual char const *get_label(char *label_buf, size_t buflen) const = 0;
-    virtual char const *get_selection_label(char *label_buf, size_t buflen) const = 0;
+    // Draw the item's name (top row) and its current value (bottom
+    // row) into an empty line.
+    virtual void render_label(LcdLine &line) const = 0;
+    virtual void render_selection(LcdLine &line) const = 0;
     
     virtual MenuId get_id() const {
         return 0;
@@ -26,22 +31,36 @@ public:
     virtual bool process_keys(KeyState const &pressed_keys, KeyState const &held_keys) {
         return false;
     }
-};
 
-/////////////////////////////////////////////////////////////////////////
+    // Whether holding left/right should keep calling process_keys
+    // (auto-repeat).  Items where a press has a side effect, like
+    // firing a relay, leave this off.
+    virtual bool accepts_repeat() const {
+        return false;
+    }
 
-class ArrayMenuItemChoice {
+    // The item's setting, for the settings store: save_state() writes
+    // get_state_size() bytes and load_state() reads them back.  Items
+    // that only act (and don't hold a setting) have no state.  Items
+    // should ignore state that doesn't make sense rather than trust
+    // it.
+    virtual uint8_t get_state_size() const {
+        return 0;
+    }
 
-public:
-    
-    ArrayMenuItemChoice(MenuId id, char const *label)
-        : _id(id), _label(label) {}
+    virtual void save_state(uint8_t *buf) const {}
 
-    char const *get_label() const { return _label; }
-    MenuId get_id() const { return _id; }
-    
-    MenuId const _id;
-    char const *const _label;
+    virtual void load_state(uint8_t const *buf) {}
+};
+
+/////////////////////////////////////////////////////////////////////////
+
+// One choice of an ArrayMenuItem.  Tables of these, and the labels
+// they point to, live in program memory, so they're only read through
+// ArrayMenuItem.
+struct ArrayMenuItemChoice {
+    MenuId id;
+    char const *label;
 };
 
 /////////////////////////////////////////////////////////////////////////
@@ -50,28 +69,39 @@ class ArrayMenuItem : public MenuItem {
 
 public:
 
-ArrayMenuItem(MenuId id, char const *label, ArrayMenuItemChoice const *const *choices, size_t num_choices, size_t initial_selection)
+    // label and the choices table are in program memory.
+    ArrayMenuItem(MenuId id, char const *label, ArrayMenuItemChoice const *choices, size_t num_choices, size_t initial_selection)
         : _label(label), _choices(choices), _num_choices(num_choices), _item_id(id), _selected(initial_selection) {
     }
     
-    virtual char const *get_label(char *label_buf, size_t buflen) const {
-        return _label;
+    virtual void render_label(LcdLine &line) const {
+        line.append_P(_label);
     }
     
     virtual size_t get_num_choices() const {
         return _num_choices;
     }
     
-    virtual char const *get_selection_label(char *label_buf, size_t buflen) const {
-        return get_choice(_selected).get_label();
+    virtual void render_selection(LcdLine &line) const {
+        line.append_P((char const *)pgm_read_ptr(&_choices[_selected].label));
     }
 
-    ArrayMenuItemChoice const &get_choice(size_t index) const {
-        return *_choices[index];
+    MenuId get_choice_id(size_t index) const {
+        return pgm_read_word(&_choices[index].id);
     }
 
-    ArrayMenuItemChoice const &get_selected_choice() const {
-        return get_choice(_selected);
+    MenuId get_selected_choice_id() const {
+        return get_choice_id(_selected);
+    }
+
+    // Select the choice with the given ID, if there is one.
+    void select_choice_id(MenuId choice_id) {
+        for (size_t i = 0; i < get_num_choices(); i++) {
+            if (get_choice_id(i) == choice_id) {
+                _selected = i;
+                return;
+            }
+        }
     }
 
     virtual MenuId get_id() const {
@@ -94,10 +124,28 @@ ArrayMenuItem(MenuId id, char const *label, ArrayMenuItemChoice const *const *ch
         return processed;
     }
 
+    virtual bool accepts_repeat() const {
+        return true;
+    }
+
+    virtual uint8_t get_state_size() const {
+        return 1;
+    }
+
+    virtual void save_state(uint8_t *buf) const {
+        buf[0] = _selected;
+    }
+
+    virtual void load_state(uint8_t const *buf) {
+        if (buf[0] < get_num_choices()) {
+            _selected = buf[0];
+        }
+    }
+
 private:
 
     char const *_label;
-    ArrayMenuItemChoice const *const *_choices;
+    ArrayMenuItemChoice const *_choices;
     size_t const _num_choices;
     MenuId const _item_id;
     
@@ -110,6 +158,7 @@ class TimeMenuItem : public MenuItem {
 
 public:
 
+    // label is in program memory.
     TimeMenuItem(MenuId id,
                  char const *label,
                  unsigned long time_step_small,
@@ -123,14 +172,12 @@ public:
           _time_step_large(time_step_large),
           _time(initial_time) {}
 
-    virtual char const *get_label(char *label_buf, size_t buflen) const { return _label; }
+    virtual void render_label(LcdLine &line) const {
+        line.append_P(_label);
+    }
     
-    virtual char const *get_selection_label(char *label_buf, size_t buflen) const {
-        snprintf(label_buf,
-                 buflen,
-                 "%lu ms", _time);
-
-        return label_buf;
+    virtual void render_selection(LcdLine &line) const {
+        line.append_number(_time).append_P(PSTR(" ms"));
     }
     
     virtual MenuId get_id() const {
@@ -140,6 +187,10 @@ public:
     virtual unsigned long get_time() const {
         return _time;
     }
+
+    void set_time(unsigned long time) {
+        _time = time;
+    }
     
     virtual bool process_keys(KeyState const &pressed_keys, KeyState const &held_keys) {
         unsigned long step = _time_step;
@@ -166,6 +217,28 @@ public:
         
         return false;
     }
+
+    virtual bool accepts_repeat() const {
+        return true;
+    }
+
+    virtual uint8_t get_state_size() const {
+        return sizeof(_time);
+    }
+
+    virtual void save_state(uint8_t *buf) const {
+        memcpy(buf, &_time, sizeof(_time));
+    }
+
+    virtual void load_state(uint8_t const *buf) {
+        unsigned long time;
+        memcpy(&time, buf, sizeof(time));
+
+        // The keys never take a time below 1 ms
+        if (time > 0) {
+            _time = time;
+        }
+    }
     
 private:
 
@@ -185,10 +258,10 @@ class Menu {
 
 public:
     
-    Menu(LiquidCrystal_I2C &lcd,
+    Menu(LcdFrameBuffer &display,
          MenuItem *const *items,
          size_t num_items)
-        : _lcd(lcd), _items(items), _num_items(num_items), _current_item_idx(0), _needs_redraw(true) {
+        : _display(display), _items(items), _num_items(num_items), _current_item_idx(0), _needs_redraw(true), _change_count(0) {
     }
     
     void redraw(bool force=false) {
@@ -196,70 +269,90 @@ public:
             return;
         }
 
-        // For space-padding the lines
-        char fmt_lcdline[16];
-        snprintf(fmt_lcdline,
-                 sizeof(fmt_lcdline) / sizeof(*fmt_lcdline),
-                 "%%-%ds", Lcd_cols);
-        
         MenuItem &item = get_current_item();
 
-        char line1_text[Lcd_cols + 1];
-        char line2_text[Lcd_cols + 1];
+        // set_line() does the space-padding
+        LcdLine line;
+        item.render_label(line);
+        _display.set_line(0, line.get_text());
 
-        char label_buf[Lcd_cols + 1];
-        char const *label;
+        line.clear();
+        item.render_selection(line);
+        _display.set_line(1, line.get_text());
 
-        label = item.get_label((char *)&label_buf,
-                               sizeof(label_buf) / sizeof(*label_buf));
-        if (!label) {
-            label = label_buf;
-        }
-        snprintf(line1_text,
-                 sizeof(line1_text) / sizeof(*line1_text),
-                 fmt_lcdline,
-                 label);
-
-
-        label = item.get_selection_label((char *)&label_buf,
-                               sizeof(label_buf) / sizeof(*label_buf));
-        if (!label) {
-            label = label_buf;
-        }
-
-        snprintf(line2_text,
-                 sizeof(line2_text) / sizeof(*line2_text),
-                 fmt_lcdline,
-                 label);
-
-        _lcd.setCursor(0, 0);
-        _lcd.print(line1_text);
-        _lcd.setCursor(0, 1);
-        _lcd.print(line2_text);
+        // Only the characters that changed actually go out to the LCD
+        _display.flush();
 
         _needs_redraw = false;
     }
 
-    KeyState process_keys(Joypad &jp) {
-        KeyState ks = jp.get_pressed();
-        KeyState heldkeys = jp.get_held();
-        
-        if (ks.key_up()) {
+    // Handle one key press.  held_keys are the keys that were down
+    // when it happened, for modifiers.  Repeats of left/right only go
+    // to items that accept them; up/down always repeat.
+    void process_keys(KeyState const &pressed_keys, KeyState const &held_keys, bool repeat=false) {
+        if (pressed_keys.key_up()) {
             if (_current_item_idx == 0) {
                 _current_item_idx = _num_items - 1;
             } else {
                 _current_item_idx--;
             }
             _needs_redraw = true;
-        } else if (ks.key_down()) {
+        } else if (pressed_keys.key_down()) {
             _current_item_idx = (_current_item_idx + 1) % _num_items;
             _needs_redraw = true;
-        } else {
-            _needs_redraw |= get_current_item().process_keys(ks, heldkeys);
+        } else if (!repeat || get_current_item().accepts_repeat()) {
+            if (get_current_item().process_keys(pressed_keys, held_keys)) {
+                mark_changed();
+            }
         }
+    }
+
+    // Goes up every time an item handles a key or the settings are
+    // replaced, so anything caching settings can tell when to look
+    // again.
+    uint16_t get_change_count() const {
+        return _change_count;
+    }
+
+    // For code that changes items directly rather than through keys.
+    void mark_changed() {
+        _change_count++;
+        _needs_redraw = true;
+    }
+
+    // Every item's state, one after the other in menu order.
+    uint8_t get_state_size() const {
+        uint8_t size = 0;
+        for (size_t i = 0; i < _num_items; i++) {
+            size += _items[i]->get_state_size();
+        }
+        return size;
+    }
 
-        redraw();
-        return ks;
+    void save_state(uint8_t *buf) const {
+        for (size_t i = 0; i < _num_items; i++) {
+            _items[i]->save_state(buf);
+            buf += _items[i]->get_state_size();
+        }
+    }
+
+    void load_state(uint8_t const *buf) {
+        for (size_t i = 0; i < _num_items; i++) {
+            _items[i]->load_state(buf);
+            buf += _items[i]->get_state_size();
+        }
+        mark_changed();
+    }
+
+    // Identifies the order, IDs and state sizes of the items, so
+    // state saved by a differently laid out menu isn't loaded.
+    uint16_t get_state_layout() const {
+        uint16_t layout = 0xffff;
+        for (size_t i = 0; i < _num_items; i++) {
+            layout = _crc16_update(layout, _items[i]->get_id());
+            layout = _crc16_update(layout, _items[i]->get_state_size());
+        }
+        return layout;
     }
 
     MenuItem &get_current_item() {
@@ -282,16 +375,14 @@ public:
 
 private:
     
-    LiquidCrystal_I2C &_lcd;
+    LcdFrameBuffer &_display;
     MenuItem *const *_items;
     size_t const _num_items;
 
     size_t _current_item_idx;
 
     bool _needs_redraw;
-    static int const Lcd_rows = 2;
-    static int const Lcd_cols = 16;
-
+    uint16_t _change_count;
 };
 
 #endif
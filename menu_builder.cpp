@@ -4,17 +4,26 @@
 
 #include "EEPROM.h"
 
+#include <avr/pgmspace.h>
+
 #include "new.h"
 #include "menu_manualcontrol.h"
+#include "menu_preset.h"
+#include "menu_sweep.h"
 #include "menu_valvecontrol.h"
+#include "menu_valvepulse.h"
+#include "settings.h"
 
 /*
  * Set up the menu.
  *
- * The ArrayMenuItem, ArrayMenuItemChoice, and Menu classes all accept
- * references to objects and don't copy them.  We need to be sure that
- * the objects we pass them stay in scope for the lifetime of the
- * Menu, so we allocate them all here as module-level globals.
+ * The menu item and Menu classes all accept references to objects and
+ * don't copy them.  We need to be sure that the objects we pass them
+ * stay in scope for the lifetime of the Menu, so we allocate them all
+ * here as module-level globals.
+ *
+ * Labels, choice tables and initial values that never change are kept
+ * in program memory, so they don't take up RAM.
  */
 
 MenuId const MenuItemIdManualControl = 0;
@@ -22,16 +31,36 @@ MenuId const MenuItemIdValveOpenTime = 1;
 MenuId const MenuItemIdValveToShutterReleaseTime = 2;
 MenuId const MenuItemIdShutterReleaseTimeReference = 3;
 MenuId const MenuItemIdValveControl = 4;
-int const MenuItemCount = 5;
+MenuId const MenuItemIdShutterReferencePulse = 5;
+
+// One item for each valve pulse after the first (the first pulse is
+// "Valve open time"), with consecutive IDs.
+MenuId const MenuItemIdValvePulseFirst = 6;
+static int const valve_pulse_num_items = ValveSequence::MaxPulses - 1;
+
+MenuId const MenuItemIdSweepMode = MenuItemIdValvePulseFirst + valve_pulse_num_items;
+MenuId const MenuItemIdSweepValveOpenTime = MenuItemIdSweepMode + 1;
+MenuId const MenuItemIdSweepShutterTime = MenuItemIdSweepMode + 2;
+MenuId const MenuItemIdSweepSettleTime = MenuItemIdSweepMode + 3;
+MenuId const MenuItemIdCueMode = MenuItemIdSweepMode + 4;
+MenuId const MenuItemIdTriggerMode = MenuItemIdSweepMode + 5;
+MenuId const MenuItemIdPreset = MenuItemIdSweepMode + 6;
+
+int const MenuItemCount = MenuItemIdPreset + 1;
 
 MenuId const MenuItemChoiceIdShutterReleasesAfterValveOpen = 0;
 MenuId const MenuItemChoiceIdShutterReleasesAfterValveClose = 1;
 
-//
-// Shared data and constants
-//
+MenuId const MenuItemChoiceIdSweepOff = 0;
+MenuId const MenuItemChoiceIdSweepValveOpenTime = 1;
+MenuId const MenuItemChoiceIdSweepShutterTime = 2;
+MenuId const MenuItemChoiceIdSweepBoth = 3;
 
-static int const label_len = 17; // 16 for an LCD row, + 1 for null terminator
+MenuId const MenuItemChoiceIdCueEveryShot = 0;
+MenuId const MenuItemChoiceIdCueKeep = 1;
+
+MenuId const MenuItemChoiceIdTriggerStartKey = 0;
+MenuId const MenuItemChoiceIdTriggerSensor = 1;
 
 //
 // Menu storage
@@ -65,7 +94,7 @@ static uint8_t menu_item_valve_control_buf[sizeof(ValveControlMenuItem)];
 
 static uint8_t menu_item_valve_open_time_buf[sizeof(TimeMenuItem)];
 
-static char const *const valve_open_time_label = "Valve open time";
+static char const valve_open_time_label[] PROGMEM = "Valve open time";
 
 // What options are available eg. 4 => 4ms, 8ms, 12ms, etc.
 static unsigned long const valve_open_time_step_small = 5;
@@ -81,7 +110,7 @@ static unsigned long const valve_open_time_initial = 25;
 
 static uint8_t menu_item_valve_shutter_time_buf[sizeof(TimeMenuItem)];
 
-static char const *const valve_shutter_time_label = "Shut. rel after";
+static char const valve_shutter_time_label[] PROGMEM = "Shut. rel after";
 
 // Number of choices
 static int const valve_shutter_time_num_choices = 50;
@@ -100,30 +129,191 @@ static unsigned long const valve_shutter_time_initial = 250;
 
 static uint8_t menu_item_valve_shutter_reference_buf[sizeof(ArrayMenuItem)];
 
-static char const *const valve_shutter_reference_label = "Shutter time ref";
+static char const valve_shutter_reference_label[] PROGMEM = "Shutter time ref";
 
-// Number of choices
-static int const valve_shutter_reference_num_choices = 2;
+static char const valve_shutter_reference_choice_open[] PROGMEM = "From valve open";
+static char const valve_shutter_reference_choice_close[] PROGMEM = "From valve close";
+
+static ArrayMenuItemChoice const valve_shutter_reference_choices[] PROGMEM = {
+    { MenuItemChoiceIdShutterReleasesAfterValveOpen, valve_shutter_reference_choice_open },
+    { MenuItemChoiceIdShutterReleasesAfterValveClose, valve_shutter_reference_choice_close }
+};
+
+//
+// Menu items: Extra valve pulses
+//
+
+static uint8_t menu_item_valve_pulse_bufs[valve_pulse_num_items][sizeof(ValvePulseMenuItem)];
+
+static unsigned long const valve_pulse_time_step_small = 1;
+static unsigned long const valve_pulse_time_step = 5;
+static unsigned long const valve_pulse_time_step_large = 25;
+
+static unsigned long const valve_pulse_gap_initial = 50;
+static unsigned long const valve_pulse_open_time_initial = 25;
+
+//
+// Menu item: Which valve pulse the shutter time is measured from
+//
+
+static uint8_t menu_item_shutter_reference_pulse_buf[sizeof(ArrayMenuItem)];
+
+static char const shutter_reference_pulse_label[] PROGMEM = "Shutter ref drop";
+
+static char const shutter_reference_pulse_choice_1[] PROGMEM = "Drop 1";
+static char const shutter_reference_pulse_choice_2[] PROGMEM = "Drop 2";
+static char const shutter_reference_pulse_choice_3[] PROGMEM = "Drop 3";
+static char const shutter_reference_pulse_choice_4[] PROGMEM = "Drop 4";
+
+// The choice ID is the drop number, counting from 0; drops that are
+// turned off don't have a place in the sequence
+static ArrayMenuItemChoice const shutter_reference_pulse_choices[ValveSequence::MaxPulses] PROGMEM = {
+    { 0, shutter_reference_pulse_choice_1 },
+    { 1, shutter_reference_pulse_choice_2 },
+    { 2, shutter_reference_pulse_choice_3 },
+    { 3, shutter_reference_pulse_choice_4 }
+};
+
+//
+// Menu item: Sweep mode (which parameters to step through)
+//
+
+static uint8_t menu_item_sweep_mode_buf[sizeof(ArrayMenuItem)];
+
+static char const sweep_mode_label[] PROGMEM = "Sweep";
+
+static char const sweep_mode_choice_off[] PROGMEM = "Off";
+static char const sweep_mode_choice_valve_open_time[] PROGMEM = "Valve open time";
+static char const sweep_mode_choice_shutter_time[] PROGMEM = "Shutter time";
+static char const sweep_mode_choice_both[] PROGMEM = "Both";
+
+static ArrayMenuItemChoice const sweep_mode_choices[] PROGMEM = {
+    { MenuItemChoiceIdSweepOff, sweep_mode_choice_off },
+    { MenuItemChoiceIdSweepValveOpenTime, sweep_mode_choice_valve_open_time },
+    { MenuItemChoiceIdSweepShutterTime, sweep_mode_choice_shutter_time },
+    { MenuItemChoiceIdSweepBoth, sweep_mode_choice_both }
+};
+
+//
+// Menu items: Sweep ranges
+//
+
+static uint8_t menu_item_sweep_valve_open_time_buf[sizeof(SweepRangeMenuItem)];
+static uint8_t menu_item_sweep_shutter_time_buf[sizeof(SweepRangeMenuItem)];
+
+static char const sweep_valve_open_time_label[] PROGMEM = "Sweep valve open";
+static char const sweep_shutter_time_label[] PROGMEM = "Sweep shut. rel";
+
+static SweepRange const sweep_valve_open_time_initial PROGMEM = { 20, 40, 5 };
+static SweepRange const sweep_shutter_time_initial PROGMEM = { 200, 300, 10 };
+
+//
+// Menu item: Sweep settle time (between shots)
+//
+
+static uint8_t menu_item_sweep_settle_time_buf[sizeof(TimeMenuItem)];
+
+static char const sweep_settle_time_label[] PROGMEM = "Sweep settle";
+
+static unsigned long const sweep_settle_time_step_small = 100;
+static unsigned long const sweep_settle_time_step = 500;
+static unsigned long const sweep_settle_time_step_large = 2000;
+
+static unsigned long const sweep_settle_time_initial = 3000;
+
+//
+// Menu item: Cue mode (cue the camera for every shot, or keep it cued
+// between shots for bursts)
+//
+
+static uint8_t menu_item_cue_mode_buf[sizeof(ArrayMenuItem)];
+
+static char const cue_mode_label[] PROGMEM = "Camera cue";
+
+static char const cue_mode_choice_every_shot[] PROGMEM = "Every shot";
+static char const cue_mode_choice_keep[] PROGMEM = "Keep (burst)";
+
+static ArrayMenuItemChoice const cue_mode_choices[] PROGMEM = {
+    { MenuItemChoiceIdCueEveryShot, cue_mode_choice_every_shot },
+    { MenuItemChoiceIdCueKeep, cue_mode_choice_keep }
+};
+
+//
+// Menu item: Trigger mode (start captures from the START key, or arm
+// them and wait for the external sensor on ICP5)
+//
+
+static uint8_t menu_item_trigger_mode_buf[sizeof(ArrayMenuItem)];
+
+static char const trigger_mode_label[] PROGMEM = "Trigger";
+
+static char const trigger_mode_choice_start_key[] PROGMEM = "START key";
+static char const trigger_mode_choice_sensor[] PROGMEM = "Sensor (pin 48)";
+
+static ArrayMenuItemChoice const trigger_mode_choices[] PROGMEM = {
+    { MenuItemChoiceIdTriggerStartKey, trigger_mode_choice_start_key },
+    { MenuItemChoiceIdTriggerSensor, trigger_mode_choice_sensor }
+};
+
+//
+// Menu item: Presets
+//
+// A preset that has never been saved to EEPROM loads its factory
+// settings from here instead.  Anything not listed keeps its current
+// value.
+//
+
+static uint8_t menu_item_preset_buf[sizeof(PresetMenuItem)];
+
+struct PresetDefaults {
+    uint16_t valve_open_time_ms;
+    uint16_t valve_shutter_time_ms;
+    MenuId valve_shutter_reference;
+    uint8_t shutter_reference_pulse;
+
+    // Extra drops after the first, all alike; 0 for none.
+    uint8_t extra_drops;
+    uint16_t extra_drop_gap_ms;
+    uint16_t extra_drop_open_time_ms;
+};
 
-// Buffer for the choice objects
-static uint8_t valve_shutter_reference_choices_buf[sizeof(ArrayMenuItemChoice) * valve_shutter_reference_num_choices];
+static char const preset_name_single[] PROGMEM = "Single drop";
+static char const preset_name_collision[] PROGMEM = "Two-drop collide";
+static char const preset_name_crown[] PROGMEM = "Splash crown";
+static char const preset_name_user[] PROGMEM = "User";
 
-// Buffer for pointers to the choice objects in valve_shutter_reference_choices_buf
-static ArrayMenuItemChoice const *valve_shutter_reference_choices_ptrs[valve_shutter_reference_num_choices];
+static char const *const preset_names[] PROGMEM = {
+    preset_name_single,
+    preset_name_collision,
+    preset_name_crown,
+    preset_name_user
+};
 
-static char const *const valve_shutter_reference_choice_labels[] = {
-    "From valve open",
-    "From valve close"
+static uint8_t const preset_num_presets = sizeof(preset_names) / sizeof(*preset_names);
+
+static PresetDefaults const preset_defaults[preset_num_presets] PROGMEM = {
+    // Single drop
+    { 25, 250, 0, 0, 0, 0, 0 },
+    // Two-drop collision: the second drop lands on the first one's
+    // rebound
+    { 25, 60, 0, 1, 1, 90, 25 },
+    // Splash crown: one big drop, shot as it hits the surface
+    { 45, 180, 0, 0, 0, 0, 0 },
+    // User
+    { 25, 250, 0, 0, 0, 0, 0 }
 };
 
 //
 // Private helpers
 //
 
+// Number of entries in a choices table
+#define NUM_CHOICES(choices) (sizeof(choices) / sizeof(*(choices)))
+
 static void add_array_menu_item(MenuId id,
                                 void *menu_item_buf,
                                 char const *label,
-                                ArrayMenuItemChoice const *const *choices,
+                                ArrayMenuItemChoice const *choices,
                                 size_t num_choices) {
 
     ArrayMenuItem *items_ptr = static_cast<ArrayMenuItem *>((void *)menu_item_buf);
@@ -160,18 +350,141 @@ static void add_valve_shutter_time_menu() {
 }
 
 static void add_valve_shutter_reference_menu() {
-
-    ArrayMenuItemChoice *choices_ptr = static_cast<ArrayMenuItemChoice *>((void *)&valve_shutter_reference_choices_buf);
-    
-    valve_shutter_reference_choices_ptrs[0] = new (&choices_ptr[0]) ArrayMenuItemChoice(MenuItemChoiceIdShutterReleasesAfterValveOpen, valve_shutter_reference_choice_labels[0]);
-
-    valve_shutter_reference_choices_ptrs[1] = new (&choices_ptr[1]) ArrayMenuItemChoice(MenuItemChoiceIdShutterReleasesAfterValveClose, valve_shutter_reference_choice_labels[1]);
-
     add_array_menu_item(MenuItemIdShutterReleaseTimeReference,
                         (void *)&menu_item_valve_shutter_reference_buf,
                         valve_shutter_reference_label,
-                        valve_shutter_reference_choices_ptrs,
-                        valve_shutter_reference_num_choices);
+                        valve_shutter_reference_choices,
+                        NUM_CHOICES(valve_shutter_reference_choices));
+}
+
+static void add_valve_pulse_menus() {
+    for (int i = 0; i < valve_pulse_num_items; i++) {
+        ValvePulseMenuItem *buf_ptr = static_cast<ValvePulseMenuItem *>((void *)&menu_item_valve_pulse_bufs[i]);
+
+        menu_items_ptrs[menu_items_count] = new (buf_ptr) ValvePulseMenuItem(MenuItemIdValvePulseFirst + i,
+                                                                             i + 2,
+                                                                             valve_pulse_time_step_small,
+                                                                             valve_pulse_time_step,
+                                                                             valve_pulse_time_step_large,
+                                                                             valve_pulse_gap_initial,
+                                                                             valve_pulse_open_time_initial);
+        menu_items_count++;
+    }
+}
+
+static void add_shutter_reference_pulse_menu() {
+    add_array_menu_item(MenuItemIdShutterReferencePulse,
+                        (void *)&menu_item_shutter_reference_pulse_buf,
+                        shutter_reference_pulse_label,
+                        shutter_reference_pulse_choices,
+                        NUM_CHOICES(shutter_reference_pulse_choices));
+}
+
+static void add_sweep_menus() {
+    add_array_menu_item(MenuItemIdSweepMode,
+                        (void *)&menu_item_sweep_mode_buf,
+                        sweep_mode_label,
+                        sweep_mode_choices,
+                        NUM_CHOICES(sweep_mode_choices));
+
+    SweepRangeMenuItem *range_ptr;
+    SweepRange range;
+
+    memcpy_P(&range, &sweep_valve_open_time_initial, sizeof(range));
+    range_ptr = static_cast<SweepRangeMenuItem *>((void *)&menu_item_sweep_valve_open_time_buf);
+    menu_items_ptrs[menu_items_count] = new (range_ptr) SweepRangeMenuItem(MenuItemIdSweepValveOpenTime,
+                                                                           sweep_valve_open_time_label,
+                                                                           valve_open_time_step_small,
+                                                                           valve_open_time_step,
+                                                                           valve_open_time_step_large,
+                                                                           range);
+    menu_items_count++;
+
+    memcpy_P(&range, &sweep_shutter_time_initial, sizeof(range));
+    range_ptr = static_cast<SweepRangeMenuItem *>((void *)&menu_item_sweep_shutter_time_buf);
+    menu_items_ptrs[menu_items_count] = new (range_ptr) SweepRangeMenuItem(MenuItemIdSweepShutterTime,
+                                                                           sweep_shutter_time_label,
+                                                                           valve_shutter_time_step_small,
+                                                                           valve_shutter_time_step,
+                                                                           valve_shutter_time_step_large,
+                                                                           range);
+    menu_items_count++;
+
+    TimeMenuItem *settle_ptr = static_cast<TimeMenuItem *>((void *)&menu_item_sweep_settle_time_buf);
+    menu_items_ptrs[menu_items_count] = new (settle_ptr) TimeMenuItem(MenuItemIdSweepSettleTime,
+                                                                      sweep_settle_time_label,
+                                                                      sweep_settle_time_step_small,
+                                                                      sweep_settle_time_step,
+                                                                      sweep_settle_time_step_large,
+                                                                      sweep_settle_time_initial);
+    menu_items_count++;
+}
+
+static void add_cue_mode_menu() {
+    add_array_menu_item(MenuItemIdCueMode,
+                        (void *)&menu_item_cue_mode_buf,
+                        cue_mode_label,
+                        cue_mode_choices,
+                        NUM_CHOICES(cue_mode_choices));
+}
+
+static void apply_preset_defaults(uint8_t preset) {
+    Menu &menu = *menu_ptr;
+    PresetDefaults defaults;
+    memcpy_P(&defaults, &preset_defaults[preset], sizeof(defaults));
+
+    ((TimeMenuItem *)menu.get_item_by_id(MenuItemIdValveOpenTime))->set_time(defaults.valve_open_time_ms);
+    ((TimeMenuItem *)menu.get_item_by_id(MenuItemIdValveToShutterReleaseTime))->set_time(defaults.valve_shutter_time_ms);
+    ((ArrayMenuItem *)menu.get_item_by_id(MenuItemIdShutterReleaseTimeReference))->select_choice_id(defaults.valve_shutter_reference);
+    ((ArrayMenuItem *)menu.get_item_by_id(MenuItemIdShutterReferencePulse))->select_choice_id(defaults.shutter_reference_pulse);
+
+    for (int i = 0; i < valve_pulse_num_items; i++) {
+        ValvePulseMenuItem &item = *((ValvePulseMenuItem *)menu.get_item_by_id(MenuItemIdValvePulseFirst + i));
+        if (i < defaults.extra_drops) {
+            item.set(true, defaults.extra_drop_gap_ms, defaults.extra_drop_open_time_ms);
+        } else {
+            item.set(false, item.get_gap(), item.get_open_time());
+        }
+    }
+
+    menu.mark_changed();
+}
+
+static void load_preset(uint8_t preset) {
+    Menu &menu = *menu_ptr;
+
+    if (!settings_load_preset(menu, preset)) {
+        apply_preset_defaults(preset);
+    }
+
+    ((PresetMenuItem *)menu.get_item_by_id(MenuItemIdPreset))->set_active(preset);
+}
+
+static void save_preset(uint8_t preset) {
+    Menu &menu = *menu_ptr;
+
+    ((PresetMenuItem *)menu.get_item_by_id(MenuItemIdPreset))->set_active(preset);
+    settings_save_preset(menu, preset);
+}
+
+static void add_preset_menu() {
+
+    PresetMenuItem *buf_ptr = static_cast<PresetMenuItem *>((void *)&menu_item_preset_buf);
+
+    menu_items_ptrs[menu_items_count] = new (buf_ptr) PresetMenuItem(MenuItemIdPreset,
+                                                                     preset_names,
+                                                                     preset_num_presets,
+                                                                     load_preset,
+                                                                     save_preset);
+    menu_items_count++;
+}
+
+static void add_trigger_mode_menu() {
+    add_array_menu_item(MenuItemIdTriggerMode,
+                        (void *)&menu_item_trigger_mode_buf,
+                        trigger_mode_label,
+                        trigger_mode_choices,
+                        NUM_CHOICES(trigger_mode_choices));
 }
 
 static void add_manual_control_menu() {
@@ -194,17 +507,24 @@ static void add_valve_control_menu() {
 // Public interface
 //
 
-Menu &build_menu(LiquidCrystal_I2C &lcd) {
+Menu &build_menu(LcdFrameBuffer &display) {
     add_manual_control_menu();
     add_valve_control_menu();
+    add_preset_menu();
     
     add_valve_open_time_menu();
     add_valve_shutter_time_menu();
     add_valve_shutter_reference_menu();
+    add_valve_pulse_menus();
+    add_shutter_reference_pulse_menu();
+
+    add_cue_mode_menu();
+    add_trigger_mode_menu();
+    add_sweep_menus();
     
     
     Menu *menu_buf_ptr = static_cast<Menu *>((void *)&menu_buf);
-    menu_ptr = new (menu_buf_ptr) Menu(lcd,
+    menu_ptr = new (menu_buf_ptr) Menu(display,
                                        (MenuItem **)menu_items_ptrs,
                                        menu_items_count);
 
@@ -229,7 +549,108 @@ unsigned long get_valve_to_shutter_time_ms() {
 MenuId get_valve_shutter_reference() {
     Menu &menu = *menu_ptr;
     ArrayMenuItem &item = *((ArrayMenuItem *)menu.get_item_by_id(MenuItemIdShutterReleaseTimeReference));
-    ArrayMenuItemChoice const &choice = item.get_selected_choice();
+    return item.get_selected_choice_id();
+}
+
+uint8_t get_shutter_reference_pulse() {
+    Menu &menu = *menu_ptr;
+    ArrayMenuItem &item = *((ArrayMenuItem *)menu.get_item_by_id(MenuItemIdShutterReferencePulse));
+
+    return item.get_selected_choice_id();
+}
+
+void get_valve_sequence(ValveSequence &sequence) {
+    Menu &menu = *menu_ptr;
+    uint8_t reference_drop = get_shutter_reference_pulse();
+
+    // Drop 1 is always there; the others only take up a place in the
+    // sequence when they're turned on
+    uint8_t shutter_pulse = (reference_drop == 0) ? 0 : ValveSequence::NoPulse;
+
+    sequence.clear();
+    sequence.add_pulse(0, get_valve_open_time_ms());
+
+    for (int i = 0; i < valve_pulse_num_items; i++) {
+        ValvePulseMenuItem &item = *((ValvePulseMenuItem *)menu.get_item_by_id(MenuItemIdValvePulseFirst + i));
+        if (item.is_enabled()) {
+            if (reference_drop == i + 1) {
+                shutter_pulse = sequence.get_num_pulses();
+            }
+            sequence.add_pulse(item.get_gap(), item.get_open_time());
+        }
+    }
+
+    sequence.set_shutter(shutter_pulse,
+                         get_valve_shutter_reference() == MenuItemChoiceIdShutterReleasesAfterValveOpen,
+                         get_valve_to_shutter_time_ms());
+}
+
+bool get_sweep(Sweep &sweep) {
+    Menu &menu = *menu_ptr;
+    ArrayMenuItem &mode_item = *((ArrayMenuItem *)menu.get_item_by_id(MenuItemIdSweepMode));
+    MenuId mode = mode_item.get_selected_choice_id();
+
+    if (mode == MenuItemChoiceIdSweepOff) {
+        return false;
+    }
+
+    SweepRangeMenuItem &open_item = *((SweepRangeMenuItem *)menu.get_item_by_id(MenuItemIdSweepValveOpenTime));
+    SweepRangeMenuItem &shutter_item = *((SweepRangeMenuItem *)menu.get_item_by_id(MenuItemIdSweepShutterTime));
+
+    if (mode == MenuItemChoiceIdSweepValveOpenTime || mode == MenuItemChoiceIdSweepBoth) {
+        sweep.set_open_time(open_item.get_range());
+    } else {
+        sweep.set_open_time(get_valve_open_time_ms());
+    }
+
+    if (mode == MenuItemChoiceIdSweepShutterTime || mode == MenuItemChoiceIdSweepBoth) {
+        sweep.set_shutter_time(shutter_item.get_range());
+    } else {
+        sweep.set_shutter_time(get_valve_to_shutter_time_ms());
+    }
+
+    sweep.rewind();
+    return true;
+}
+
+unsigned long get_sweep_settle_time_ms() {
+    Menu &menu = *menu_ptr;
+    TimeMenuItem &item = *((TimeMenuItem *)menu.get_item_by_id(MenuItemIdSweepSettleTime));
+
+    return item.get_time();
+}
+
+bool get_keep_camera_cued() {
+    Menu &menu = *menu_ptr;
+    ArrayMenuItem &item = *((ArrayMenuItem *)menu.get_item_by_id(MenuItemIdCueMode));
+
+    return item.get_selected_choice_id() == MenuItemChoiceIdCueKeep;
+}
+
+bool get_use_sensor_trigger() {
+    Menu &menu = *menu_ptr;
+    ArrayMenuItem &item = *((ArrayMenuItem *)menu.get_item_by_id(MenuItemIdTriggerMode));
+
+    return item.get_selected_choice_id() == MenuItemChoiceIdTriggerSensor;
+}
+
+CaptureSettings const &get_capture_settings() {
+    static CaptureSettings settings;
+    static bool settings_valid = false;
+    static uint16_t settings_change_count;
+
+    Menu &menu = *menu_ptr;
+
+    if (!settings_valid || menu.get_change_count() != settings_change_count) {
+        get_valve_sequence(settings.sequence);
+        settings.sweeping = get_sweep(settings.sweep);
+        settings.sweep_settle_time_ms = get_sweep_settle_time_ms();
+        settings.keep_camera_cued = get_keep_camera_cued();
+        settings.use_sensor_trigger = get_use_sensor_trigger();
+
+        settings_valid = true;
+        settings_change_count = menu.get_change_count();
+    }
 
-    return choice.get_id();
+    return settings;
 }
@@ -1,24 +1,78 @@
 #ifndef MENUOPTIONS_H_
 #define MENUOPTIONS_H_
 
-#include "LiquidCrystal_I2C.h"
-
+#include "lcd_framebuffer.h"
 #include "menu.h"
+#include "sweep.h"
+#include "valve_sequence.h"
 
 extern MenuId const MenuItemIdManualControl;
 extern MenuId const MenuItemIdValveOpenTime;
 extern MenuId const MenuItemIdValveToShutterReleaseTime;
 extern MenuId const MenuItemIdShutterReleaseTimeReference;
 extern MenuId const MenuItemIdValveControl;
+extern MenuId const MenuItemIdValvePulseFirst;
+extern MenuId const MenuItemIdShutterReferencePulse;
+extern MenuId const MenuItemIdSweepMode;
+extern MenuId const MenuItemIdSweepValveOpenTime;
+extern MenuId const MenuItemIdSweepShutterTime;
+extern MenuId const MenuItemIdSweepSettleTime;
+extern MenuId const MenuItemIdCueMode;
+extern MenuId const MenuItemIdTriggerMode;
+extern MenuId const MenuItemIdPreset;
 extern int const MenuItemCount;
 
 extern MenuId const MenuItemChoiceIdShutterReleasesAfterValveOpen;
 extern MenuId const MenuItemChoiceIdShutterReleasesAfterValveClose;
 
-Menu &build_menu(LiquidCrystal_I2C &lcd);
+extern MenuId const MenuItemChoiceIdSweepOff;
+extern MenuId const MenuItemChoiceIdSweepValveOpenTime;
+extern MenuId const MenuItemChoiceIdSweepShutterTime;
+extern MenuId const MenuItemChoiceIdSweepBoth;
+
+extern MenuId const MenuItemChoiceIdCueEveryShot;
+extern MenuId const MenuItemChoiceIdCueKeep;
+
+extern MenuId const MenuItemChoiceIdTriggerStartKey;
+extern MenuId const MenuItemChoiceIdTriggerSensor;
+
+Menu &build_menu(LcdFrameBuffer &display);
 
 unsigned long get_valve_open_time_ms();
 unsigned long get_valve_to_shutter_time_ms();
 MenuId get_valve_shutter_reference();
+uint8_t get_shutter_reference_pulse();
+
+// Fill in the valve pulses and shutter timing from the menu settings.
+void get_valve_sequence(ValveSequence &sequence);
+
+// Set up a parameter sweep from the menu settings.  Returns false if
+// sweeping is turned off.
+bool get_sweep(Sweep &sweep);
+unsigned long get_sweep_settle_time_ms();
+
+// Whether to keep the camera cued between captures (burst mode).
+bool get_keep_camera_cued();
+
+// Whether captures wait for the external sensor trigger.
+bool get_use_sensor_trigger();
+
+// Everything a capture needs from the menu, worked out once whenever
+// the settings change (eg. a preset is loaded) rather than looked up
+// item by item for every shot.
+struct CaptureSettings {
+    // Pulses and shutter timing; the cue settings are left to the
+    // caller.
+    ValveSequence sequence;
+
+    bool sweeping;
+    Sweep sweep;
+    unsigned long sweep_settle_time_ms;
+
+    bool keep_camera_cued;
+    bool use_sensor_trigger;
+};
+
+CaptureSettings const &get_capture_settings();
 
 #endif
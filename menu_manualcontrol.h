@@ -14,8 +14,8 @@ public:
                                        _item_id(id) {
     }
     
-    virtual char const *get_label(char *label_buf, size_t buflen) const {
-        return "Camera control";
+    virtual void render_label(LcdLine &line) const {
+        line.append_P(PSTR("Camera control"));
     }
 
     // We supply one "null" choice because we don't actually have any
@@ -24,15 +24,15 @@ public:
         return 1;
     }
     
-    virtual char const *get_selection_label(char *label_buf, size_t buflen) const {
+    virtual void render_selection(LcdLine &line) const {
         if (_camera_state == 0) {
-            return "A: Cue shutter";
+            line.append_P(PSTR("A: Cue shutter"));
         } else if (_camera_state == 1) {
-            return "A: Rel / B: Abrt";
+            line.append_P(PSTR("A: Rel / B: Abrt"));
         } else if (_camera_state == 2) {
-            return "Triggered";
+            line.append_P(PSTR("Triggered"));
         } else {
-            return "??? Press B ???";
+            line.append_P(PSTR("??? Press B ???"));
         }
     }
 
@@ -0,0 +1,26 @@
+#include "menu_preset.h"
+
+#include <avr/pgmspace.h>
+
+void PresetMenuItem::render_selection(LcdLine &line) const {
+    line.append((_shown == _active) ? '*' : ' ');
+    line.append_P((char const *)pgm_read_ptr(&_names[_shown]));
+}
+
+bool PresetMenuItem::process_keys(KeyState const &pressed_keys, KeyState const &held_keys) {
+    if (pressed_keys.key_right()) {
+        _shown = (_shown + 1) % _num_presets;
+        return true;
+    } else if (pressed_keys.key_left()) {
+        _shown = (_shown == 0) ? _num_presets - 1 : _shown - 1;
+        return true;
+    } else if (pressed_keys.key_select()) {
+        _load(_shown);
+        return true;
+    } else if (pressed_keys.key_x()) {
+        _save(_shown);
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,77 @@
+#ifndef MENU_PRESET_H_
+#define MENU_PRESET_H_
+
+#include <stdint.h>
+
+#include "menu.h"
+
+// Called with a preset number to load or save it.
+typedef void (*PresetAction)(uint8_t preset);
+
+// Picks one of a handful of named presets.  Left/right browse the
+// presets, SELECT loads the one shown into every other item, and X
+// saves the current settings over it.  The preset last loaded or saved
+// is marked with a '*'.
+class PresetMenuItem : public MenuItem {
+
+public:
+
+    // names is an array of num_presets strings in program memory.
+    PresetMenuItem(MenuId id,
+                   char const *const *names,
+                   uint8_t num_presets,
+                   PresetAction load,
+                   PresetAction save)
+        : _id(id),
+          _names(names),
+          _num_presets(num_presets),
+          _load(load),
+          _save(save),
+          _shown(0),
+          _active(0) {}
+
+    virtual void render_label(LcdLine &line) const {
+        line.append_P(PSTR("Preset SEL:load"));
+    }
+
+    virtual void render_selection(LcdLine &line) const;
+
+    virtual MenuId get_id() const {
+        return _id;
+    }
+
+    virtual bool process_keys(KeyState const &pressed_keys, KeyState const &held_keys);
+
+    void set_active(uint8_t preset) {
+        _active = preset;
+        _shown = preset;
+    }
+
+    // Only the active preset is a setting; what's being browsed isn't.
+    virtual uint8_t get_state_size() const {
+        return 1;
+    }
+
+    virtual void save_state(uint8_t *buf) const {
+        buf[0] = _active;
+    }
+
+    virtual void load_state(uint8_t const *buf) {
+        if (buf[0] < _num_presets) {
+            set_active(buf[0]);
+        }
+    }
+
+private:
+
+    MenuId const _id;
+    char const *const *_names;
+    uint8_t const _num_presets;
+    PresetAction const _load;
+    PresetAction const _save;
+
+    uint8_t _shown;
+    uint8_t _active;
+};
+
+#endif
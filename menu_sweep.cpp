@@ -0,0 +1,68 @@
+#include "menu_sweep.h"
+
+static void append_field(LcdLine &line, unsigned long value, bool editing) {
+    if (editing) {
+        line.append('[').append_number(value).append(']');
+    } else {
+        line.append_number(value);
+    }
+}
+
+void SweepRangeMenuItem::render_selection(LcdLine &line) const {
+    // eg. "[250]-1500 +25"; the brackets mark the field being edited
+    append_field(line, _range.start, _field == 0);
+    line.append('-');
+    append_field(line, _range.stop, _field == 1);
+    line.append_P(PSTR(" +"));
+    append_field(line, _range.step, _field == 2);
+}
+
+bool SweepRangeMenuItem::process_keys(KeyState const &pressed_keys, KeyState const &held_keys) {
+    if (pressed_keys.key_select()) {
+        _field = (_field + 1) % NumFields;
+        return true;
+    }
+
+    unsigned long step = _time_step;
+
+    if (held_keys.key_a()) {
+        step = _time_step_large;
+    }
+
+    if (held_keys.key_b()) {
+        step = _time_step_small;
+    }
+
+    unsigned long *value;
+    if (_field == 0) {
+        value = &_range.start;
+    } else if (_field == 1) {
+        value = &_range.stop;
+    } else {
+        value = &_range.step;
+    }
+
+    if (pressed_keys.key_left()) {
+        if (*value >= step) {
+            *value -= step;
+            return true;
+        }
+    }
+
+    if (pressed_keys.key_right()) {
+        *value += step;
+        return true;
+    }
+
+    return false;
+}
+
+void SweepRangeMenuItem::save_state(uint8_t *buf) const {
+    memcpy(buf, &_range, sizeof(_range));
+}
+
+void SweepRangeMenuItem::load_state(uint8_t const *buf) {
+    // Any range can be set from the keys (a zero step just means a
+    // single value), so any range is fine to load
+    memcpy(&_range, buf, sizeof(_range));
+}
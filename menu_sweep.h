@@ -0,0 +1,75 @@
+#ifndef MENU_SWEEP_H_
+#define MENU_SWEEP_H_
+
+#include <stdint.h>
+
+#include "menu.h"
+#include "sweep.h"
+
+// Start, stop and step of a swept time.  SELECT moves between the
+// three fields and left/right change the selected one, with the same
+// A/B step modifiers as TimeMenuItem.
+class SweepRangeMenuItem : public MenuItem {
+
+public:
+
+    // label is in program memory.
+    SweepRangeMenuItem(MenuId id,
+                       char const *label,
+                       unsigned long time_step_small,
+                       unsigned long time_step,
+                       unsigned long time_step_large,
+                       SweepRange const &initial_range)
+        : _id(id),
+          _label(label),
+          _time_step_small(time_step_small),
+          _time_step(time_step),
+          _time_step_large(time_step_large),
+          _range(initial_range),
+          _field(0) {}
+
+    virtual void render_label(LcdLine &line) const {
+        line.append_P(_label);
+    }
+
+    virtual void render_selection(LcdLine &line) const;
+
+    virtual MenuId get_id() const {
+        return _id;
+    }
+
+    SweepRange const &get_range() const {
+        return _range;
+    }
+
+    virtual bool process_keys(KeyState const &pressed_keys, KeyState const &held_keys);
+
+    virtual bool accepts_repeat() const {
+        return true;
+    }
+
+    virtual uint8_t get_state_size() const {
+        return sizeof(_range);
+    }
+
+    virtual void save_state(uint8_t *buf) const;
+    virtual void load_state(uint8_t const *buf);
+
+private:
+
+    static uint8_t const NumFields = 3;
+
+    MenuId const _id;
+    char const *_label;
+
+    unsigned long const _time_step_small;
+    unsigned long const _time_step;
+    unsigned long const _time_step_large;
+
+    SweepRange _range;
+
+    // 0 = start, 1 = stop, 2 = step
+    uint8_t _field;
+};
+
+#endif
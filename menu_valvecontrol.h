@@ -13,8 +13,8 @@ public:
     ValveControlMenuItem(MenuId id) : _valve_state(0),
                                       _item_id(id) {}
     
-    virtual char const *get_label(char *label_buf, size_t buflen) const {
-        return "Valve control";
+    virtual void render_label(LcdLine &line) const {
+        line.append_P(PSTR("Valve control"));
     }
 
     // We supply one "null" choice because we don't actually have any
@@ -23,15 +23,15 @@ public:
         return 1;
     }
     
-    virtual char const *get_selection_label(char *label_buf, size_t buflen) const {
+    virtual void render_selection(LcdLine &line) const {
         if (_valve_state == 0) {
-            return "SEL or B: Open";
+            line.append_P(PSTR("SEL or B: Open"));
         } else if (_valve_state == 1) {
-            return "SEL: Close";
+            line.append_P(PSTR("SEL: Close"));
         } else if (_valve_state == 2) {
-            return "Release to close";
+            line.append_P(PSTR("Release to close"));
         } else {
-            return "???";
+            line.append_P(PSTR("???"));
         }
     }
 
@@ -0,0 +1,77 @@
+#include "menu_valvepulse.h"
+
+void ValvePulseMenuItem::render_selection(LcdLine &line) const {
+    if (!_enabled) {
+        line.append_P(PSTR("Off (X: enable)"));
+        return;
+    }
+
+    // eg. "[250] 40 ms"; the brackets mark the time being edited
+    line.append(_editing_open_time ? ' ' : '[')
+        .append_number(_gap)
+        .append_P(_editing_open_time ? PSTR(" [") : PSTR("] "))
+        .append_number(_open_time)
+        .append_P(_editing_open_time ? PSTR("] ms") : PSTR(" ms"));
+}
+
+bool ValvePulseMenuItem::process_keys(KeyState const &pressed_keys, KeyState const &held_keys) {
+    if (pressed_keys.key_x()) {
+        _enabled = !_enabled;
+        return true;
+    }
+
+    if (!_enabled) {
+        return false;
+    }
+
+    if (pressed_keys.key_select()) {
+        _editing_open_time = !_editing_open_time;
+        return true;
+    }
+
+    unsigned long step = _time_step;
+
+    if (held_keys.key_a()) {
+        step = _time_step_large;
+    }
+
+    if (held_keys.key_b()) {
+        step = _time_step_small;
+    }
+
+    unsigned long &value = _editing_open_time ? _open_time : _gap;
+
+    if (pressed_keys.key_left()) {
+        if (value > step) {
+            value -= step;
+            return true;
+        }
+    }
+
+    if (pressed_keys.key_right()) {
+        value += step;
+        return true;
+    }
+
+    return false;
+}
+
+void ValvePulseMenuItem::save_state(uint8_t *buf) const {
+    buf[0] = _enabled;
+    memcpy(&buf[1], &_gap, sizeof(_gap));
+    memcpy(&buf[1 + sizeof(_gap)], &_open_time, sizeof(_open_time));
+}
+
+void ValvePulseMenuItem::load_state(uint8_t const *buf) {
+    unsigned long gap;
+    unsigned long open_time;
+    memcpy(&gap, &buf[1], sizeof(gap));
+    memcpy(&open_time, &buf[1 + sizeof(gap)], sizeof(open_time));
+
+    // Like TimeMenuItem, the keys never take either time below 1 ms
+    if (gap > 0 && open_time > 0) {
+        _enabled = (buf[0] != 0);
+        _gap = gap;
+        _open_time = open_time;
+    }
+}
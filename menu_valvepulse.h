@@ -0,0 +1,90 @@
+#ifndef MENU_VALVEPULSE_H_
+#define MENU_VALVEPULSE_H_
+
+#include <stdint.h>
+
+#include "menu.h"
+
+// Gap and open time for one extra valve pulse (drop) in a capture.
+// X enables or disables the drop, SELECT switches between editing the
+// gap and the open time, and left/right change the value with the same
+// A/B step modifiers as TimeMenuItem.
+class ValvePulseMenuItem : public MenuItem {
+
+public:
+
+    ValvePulseMenuItem(MenuId id,
+                       uint8_t drop_number,
+                       unsigned long time_step_small,
+                       unsigned long time_step,
+                       unsigned long time_step_large,
+                       unsigned long initial_gap,
+                       unsigned long initial_open_time)
+        : _id(id),
+          _drop_number(drop_number),
+          _time_step_small(time_step_small),
+          _time_step(time_step),
+          _time_step_large(time_step_large),
+          _gap(initial_gap),
+          _open_time(initial_open_time),
+          _enabled(false),
+          _editing_open_time(false) {}
+
+    virtual void render_label(LcdLine &line) const {
+        line.append_P(PSTR("Drop ")).append_number(_drop_number).append_P(PSTR(" gap/open"));
+    }
+
+    virtual void render_selection(LcdLine &line) const;
+
+    virtual MenuId get_id() const {
+        return _id;
+    }
+
+    bool is_enabled() const {
+        return _enabled;
+    }
+
+    unsigned long get_gap() const {
+        return _gap;
+    }
+
+    unsigned long get_open_time() const {
+        return _open_time;
+    }
+
+    void set(bool enabled, unsigned long gap, unsigned long open_time) {
+        _enabled = enabled;
+        _gap = gap;
+        _open_time = open_time;
+    }
+
+    virtual bool process_keys(KeyState const &pressed_keys, KeyState const &held_keys);
+
+    virtual bool accepts_repeat() const {
+        return true;
+    }
+
+    virtual uint8_t get_state_size() const {
+        return 1 + sizeof(_gap) + sizeof(_open_time);
+    }
+
+    virtual void save_state(uint8_t *buf) const;
+    virtual void load_state(uint8_t const *buf);
+
+private:
+
+    MenuId const _id;
+    uint8_t const _drop_number;
+
+    unsigned long const _time_step_small;
+    unsigned long const _time_step;
+    unsigned long const _time_step_large;
+
+    unsigned long _gap;
+    unsigned long _open_time;
+
+    bool _enabled;
+    bool _editing_open_time;
+};
+
+#endif
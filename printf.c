@@ -31,6 +31,13 @@
 
 #include "printf.h"
 
+#include <limits.h>
+
+#ifdef PRINTF_BENCHMARK
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#endif
+
 typedef void (*putcf) (void*,char);
 static putcf stdout_putf;
 static void* stdout_putp;
@@ -41,7 +48,7 @@ static void* stdout_putp;
 static void uli2a(unsigned long int num, unsigned int base, int uc,char * bf)
 	{
 	int n=0;
-	unsigned int d=1;
+	unsigned long int d=1;
 	while (num/d >= base)
 		d*=base;		 
 	while (d!=0) {
@@ -56,13 +63,57 @@ static void uli2a(unsigned long int num, unsigned int base, int uc,char * bf)
 	*bf=0;
 	}
 
+/*
+ * Decimal conversion without division: each digit is found by
+ * subtracting its power of ten until it won't go, which on the AVR
+ * is far cheaper than the software 32-bit divide uli2a does per digit.
+ * With frac non-zero, the last frac digits are printed after a point,
+ * with at least one digit before it.
+ */
+static unsigned long const uli2da_powers[] = {
+	1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+	10000UL, 1000UL, 100UL, 10UL, 1UL
+	};
+
+#define ULI2DA_DIGITS (sizeof(uli2da_powers)/sizeof(uli2da_powers[0]))
+
+static void uli2da(unsigned long int num, unsigned char frac, char * bf)
+	{
+	unsigned char n=0;
+	unsigned char i;
+	for (i=0; i<ULI2DA_DIGITS; i++) {
+		unsigned long int p = uli2da_powers[i];
+		char dgt='0';
+		while (num >= p) {
+			num-=p;
+			dgt++;
+			}
+		if (frac && i==ULI2DA_DIGITS-frac) {
+			if (!n)
+				*bf++ = '0';
+			*bf++ = '.';
+			n=1;
+			}
+		if (n || dgt>'0' || i==ULI2DA_DIGITS-1) {
+			*bf++ = dgt;
+			n=1;
+			}
+		}
+	*bf=0;
+	}
+
+void tfp_ultoa(unsigned long int num, char * bf)
+	{
+	uli2da(num,0,bf);
+	}
+
 static void li2a (long num, char * bf)
 	{
 	if (num<0) {
 		num=-num;
 		*bf++ = '-';
 		}
-	uli2a(num,10,0,bf);
+	uli2da(num,0,bf);
 	}
 
 #endif
@@ -85,13 +136,39 @@ static void ui2a(unsigned int num, unsigned int base, int uc,char * bf)
 	*bf=0;
 	}
 
+/*
+ * The same for unsigned ints, with 16-bit arithmetic.
+ */
+static void ui2da(unsigned int num, char * bf)
+	{
+#if UINT_MAX > 0xffff
+	uli2da(num,0,bf);
+#else
+	static unsigned int const powers[] = { 10000, 1000, 100, 10, 1 };
+	unsigned char n=0;
+	unsigned char i;
+	for (i=0; i<sizeof(powers)/sizeof(powers[0]); i++) {
+		char dgt='0';
+		while (num >= powers[i]) {
+			num-=powers[i];
+			dgt++;
+			}
+		if (n || dgt>'0' || powers[i]==1) {
+			*bf++ = dgt;
+			n=1;
+			}
+		}
+	*bf=0;
+#endif
+	}
+
 static void i2a (int num, char * bf)
 	{
 	if (num<0) {
 		num=-num;
 		*bf++ = '-';
 		}
-	ui2a(num,10,0,bf);
+	ui2da(num,bf);
 	}
 
 static int a2d(char ch)
@@ -169,10 +246,10 @@ void tfp_format(void* putp,putcf putf,char const *fmt, va_list va)
 				case 'u' : {
 #ifdef 	PRINTF_LONG_SUPPORT
 					if (lng)
-						uli2a(va_arg(va, unsigned long int),10,0,bf);
+						uli2da(va_arg(va, unsigned long int),0,bf);
 					else
 #endif
-					ui2a(va_arg(va, unsigned int),10,0,bf);
+					ui2da(va_arg(va, unsigned int),bf);
 					putchw(putp,putf,w,lz,bf);
 					break;
 					}
@@ -195,6 +272,12 @@ void tfp_format(void* putp,putcf putf,char const *fmt, va_list va)
 					ui2a(va_arg(va, unsigned int),16,(ch=='X'),bf);
 					putchw(putp,putf,w,lz,bf);
 					break;
+#ifdef 	PRINTF_LONG_SUPPORT
+				case 'k' :
+					uli2da(va_arg(va, unsigned long int),3,bf);
+					putchw(putp,putf,w,lz,bf);
+					break;
+#endif
 				case 'c' : 
 					putf(putp,(char)(va_arg(va, int)));
 					break;
@@ -226,6 +309,11 @@ void tfp_printf(char const *fmt, ...)
 	va_end(va);
 	}
 
+void tfp_vprintf(char const *fmt, va_list va)
+	{
+	tfp_format(stdout_putp,stdout_putf,fmt,va);
+	}
+
 static void putcp(void* p,char c)
 	{
 	*(*((char**)p))++ = c;
@@ -242,4 +330,44 @@ void tfp_sprintf(char* s,char const *fmt, ...)
 	va_end(va);
 	}
 
+#ifdef PRINTF_BENCHMARK
+
+/*
+ * Time the old (uli2a, dividing) and new (uli2da, subtracting)
+ * decimal conversions with Timer1 running at the CPU clock.  Timer1
+ * is otherwise unused; its settings are put back afterwards.
+ */
+void tfp_benchmark(void)
+	{
+	static unsigned long const values[] = {
+		0UL, 7UL, 250UL, 65535UL, 1234567UL, 4294967295UL
+		};
+	char bf[12];
+	unsigned char i;
+	unsigned char tccr1a=TCCR1A;
+	unsigned char tccr1b=TCCR1B;
+
+	TCCR1A=0;
+	TCCR1B=_BV(CS10);
+
+	tfp_printf("Cycles per conversion: value, divide / subtract\n");
+	for (i=0; i<sizeof(values)/sizeof(values[0]); i++) {
+		unsigned int t0,t1,t2;
+		unsigned char sreg=SREG;
+		cli();
+		t0=TCNT1;
+		uli2a(values[i],10,0,bf);
+		t1=TCNT1;
+		uli2da(values[i],0,bf);
+		t2=TCNT1;
+		SREG=sreg;
+		tfp_printf("%lu: %u / %u\n",values[i],t1-t0,t2-t1);
+		}
+
+	TCCR1A=tccr1a;
+	TCCR1B=tccr1b;
+	}
+
+#endif
+
 
@@ -47,6 +47,10 @@ Two printf variants are provided: printf and sprintf.
 
 The formats supported by this implementation are: 'd' 'u' 'c' 's' 'x' 'X'.
 
+With long support there is also 'k', which prints an unsigned long in
+thousandths with a decimal point, so 12345 microseconds comes out as
+"12.345" milliseconds.  It always takes an unsigned long; no 'l' is needed.
+
 Zero padding and field width are also supported.
 
 If the library is compiled with 'PRINTF_SUPPORT_LONG' defined then the 
@@ -106,6 +110,13 @@ regs Kusti, 23.10.2004
 #ifndef __TFP_PRINTF__
 #define __TFP_PRINTF__
 
+// Times are kept in unsigned longs, so we need %lu.
+#define PRINTF_LONG_SUPPORT
+
+// Build tfp_benchmark(), which compares the decimal conversions over
+// serial (the 'b' command).
+// #define PRINTF_BENCHMARK
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -115,10 +126,19 @@ extern "C" {
 void init_printf(void* putp,void (*putf) (void*,char));
 
 void tfp_printf(char const* fmt, ...);
+void tfp_vprintf(char const* fmt, va_list va);
 void tfp_sprintf(char * s, char const *cfmt, ...);
 
+#ifdef PRINTF_BENCHMARK
+void tfp_benchmark(void);
+#endif
+
 void tfp_format(void* putp,void (*putf) (void*,char),char const *fmt, va_list va);
 
+// The decimal conversion behind %lu on its own, for callers that
+// don't need a format; bf must have room for 11 characters.
+void tfp_ultoa(unsigned long num, char * bf);
+
 #define dprintf tfp_printf 
 #define dsprintf tfp_sprintf 
 
@@ -1,26 +1,49 @@
 #include "relays.h"
+
+#include <util/atomic.h>
+
 #include "printf.h"
 
+// Indexed by the RelayIndex* constants.
 static Relay relays[] = {
-    Relay(&PORTH, &DDRH, PORTH0, true),
-    Relay(&PORTD, &DDRD, PORTD3, true),
-    Relay(&PORTD, &DDRD, PORTD2, false)
+    CueShutterRelay::runtime(),
+    ReleaseShutterRelay::runtime(),
+    ValveRelay::runtime()
 };
 
 Relay &relay(uint8_t num) {
     return relays[num];
 }
 
+uint8_t get_num_relays() {
+    return sizeof(relays) / sizeof(*relays);
+}
+
+void open_all_relays() {
+    RelayGroup group;
+    for (size_t i = 0; i < sizeof(relays) / sizeof(*relays); i++) {
+        group.open(i);
+    }
+    group.commit();
+}
+
 //
 // Relay class implementation
 //
 
+// The port may be shared with relays switched from the capture ISR,
+// so the read-modify-write has to be atomic.
+
 void Relay::drop() {
-    *_port &= ~_BV(_pin);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *_port &= ~_BV(_pin);
+    }
 }
 
 void Relay::raise() {
-    *_port |= _BV(_pin);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *_port |= _BV(_pin);
+    }
 }
 
 void Relay::open() {
@@ -39,3 +62,47 @@ bool Relay::is_closed() {
     return (bool)(!(*_port & _BV(_pin))) == _invert;
 }
 
+//
+// RelayGroup class implementation
+//
+
+void RelayGroup::stage(uint8_t relay_index, bool close) {
+    Relay &r = relay(relay_index);
+    uint8_t volatile *port = r.get_port();
+    uint8_t mask = r.get_mask();
+    bool set = (close == r.close_sets_bit());
+
+    uint8_t i = 0;
+    while (i < _num_ports && _ports[i].port != port) {
+        i++;
+    }
+
+    if (i == _num_ports) {
+        if (_num_ports >= MaxPorts) {
+            dprintf("RelayGroup: too many ports\n");
+            return;
+        }
+        _ports[i].port = port;
+        _ports[i].set_mask = 0;
+        _ports[i].clear_mask = 0;
+        _num_ports++;
+    }
+
+    PortChange &change = _ports[i];
+    if (set) {
+        change.set_mask |= mask;
+        change.clear_mask &= ~mask;
+    } else {
+        change.clear_mask |= mask;
+        change.set_mask &= ~mask;
+    }
+}
+
+void RelayGroup::commit() const {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i = 0; i < _num_ports; i++) {
+            PortChange const &change = _ports[i];
+            *change.port = (*change.port & ~change.clear_mask) | change.set_mask;
+        }
+    }
+}
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <avr/io.h>
+#include <util/atomic.h>
 #include "Arduino.h"
 
 class Relay {
@@ -20,6 +21,15 @@ public:
 
     bool is_open();
     bool is_closed();
+
+    // Port and pin mask driving this relay, for code that wants to
+    // write several relays' port bits at once.
+    inline uint8_t volatile *get_port() const { return _port; }
+    inline uint8_t get_mask() const { return _BV(_pin); }
+
+    // Whether closing the relay sets its port bit (as opposed to
+    // clearing it).
+    inline bool close_sets_bit() const { return !_invert; }
     
 private:
 
@@ -31,7 +41,134 @@ private:
     bool const _invert;
 };
 
+// Stages open/close changes to several relays and then applies them
+// together.  commit() writes each affected port exactly once, with
+// interrupts disabled, so relays on the same port switch on the same
+// instruction and nothing an ISR does to the port in the meantime is
+// lost.
+//
+//     RelayGroup group;
+//     group.open(RelayIndexReleaseShutter).open(RelayIndexCueShutter);
+//     group.commit();
+class RelayGroup {
+
+public:
+
+    RelayGroup() : _num_ports(0) {}
+
+    RelayGroup &open(uint8_t relay_index) {
+        stage(relay_index, false);
+        return *this;
+    }
+
+    RelayGroup &close(uint8_t relay_index) {
+        stage(relay_index, true);
+        return *this;
+    }
+
+    // Apply the staged changes.  The group can be committed again, or
+    // cleared and reused.
+    void commit() const;
+
+    void clear() {
+        _num_ports = 0;
+    }
+
+private:
+
+    void stage(uint8_t relay_index, bool close);
+
+    struct PortChange {
+        uint8_t volatile *port;
+        uint8_t set_mask;
+        uint8_t clear_mask;
+    };
+
+    static uint8_t const MaxPorts = 4;
+
+    PortChange _ports[MaxPorts];
+    uint8_t _num_ports;
+};
+
+// Port descriptors for StaticRelay.  The accessors inline to fixed
+// register addresses.  IoSpace says whether the port is in the
+// bottom 32 I/O registers, where sbi/cbi can set or clear a bit with
+// one (atomic) instruction.
+struct RelayPortD {
+    static bool const IoSpace = true;
+    static inline uint8_t volatile &port() { return PORTD; }
+    static inline uint8_t volatile &ddr() { return DDRD; }
+};
+
+struct RelayPortH {
+    static bool const IoSpace = false;
+    static inline uint8_t volatile &port() { return PORTH; }
+    static inline uint8_t volatile &ddr() { return DDRH; }
+};
+
+// A relay whose port, pin and polarity are fixed at compile time.
+// open() and close() compile down to a single sbi/cbi on I/O-space
+// ports, with no pointer loads or polarity tests; ports outside I/O
+// space get a short read-modify-write with interrupts disabled.
+template <class Port, uint8_t Pin, bool Invert>
+class StaticRelay {
+
+public:
+
+    static inline void open() {
+        Invert ? raise() : drop();
+    }
+
+    static inline void close() {
+        Invert ? drop() : raise();
+    }
+
+    static inline bool is_open() {
+        return (bool)(!!(Port::port() & _BV(Pin))) == Invert;
+    }
+
+    static inline bool is_closed() {
+        return !is_open();
+    }
+
+    // A runtime Relay for the same pin, for the relay(n) table.
+    static Relay runtime() {
+        return Relay(&Port::port(), &Port::ddr(), Pin, Invert);
+    }
+
+private:
+
+    static inline void drop() {
+        if (Port::IoSpace) {
+            Port::port() &= ~_BV(Pin);
+        } else {
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                Port::port() &= ~_BV(Pin);
+            }
+        }
+    }
+
+    static inline void raise() {
+        if (Port::IoSpace) {
+            Port::port() |= _BV(Pin);
+        } else {
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                Port::port() |= _BV(Pin);
+            }
+        }
+    }
+};
+
+// Our relays (see the README for wiring).
+typedef StaticRelay<RelayPortH, PORTH0, true> CueShutterRelay;
+typedef StaticRelay<RelayPortD, PORTD3, true> ReleaseShutterRelay;
+typedef StaticRelay<RelayPortD, PORTD2, false> ValveRelay;
+
 Relay &relay(uint8_t num);
+uint8_t get_num_relays();
+
+// Put every relay back in its resting (open) state, all at once.
+void open_all_relays();
 
 
 #endif
@@ -12,10 +12,19 @@
 
 #include "printf.h"
 
+#include "capture.h"
+#include "capture_controller.h"
+#include "edge_recorder.h"
 #include "joypad.h"
+#include "latency.h"
+#include "log.h"
+#include "lcd_framebuffer.h"
+#include "lcd_line.h"
 #include "menu.h"
 #include "menu_builder.h"
 #include "relays.h"
+#include "settings.h"
+#include "uart.h"
 #include "constants.h"
 
 /*
@@ -39,6 +48,14 @@
  * Timer3 is being used to drive the NES joypad clock and latch
  * operation.
  *
+ * ## Timer5
+ *
+ * Timer5 free-runs at clkIO/8 as the capture timebase.  Its
+ * output-compare interrupt drives the relay edges of a synchronized
+ * capture (see CaptureEngine).  Its input capture unit latches the
+ * external sensor trigger on ICP5 (PL1, digital pin 48), so triggered
+ * captures are timed from the edge itself.
+ *
  * ## Relays
  *
  * The relay board has 8 relays, each with one active-low input.  I'm
@@ -66,51 +83,26 @@ void set_led(bool on) {
 // Main
 //
 
+static unsigned long const Serial_baud = 9600;
+
 extern "C" {
     void serial_putc(void *p, char c) {
-        Serial.print(c);
-        Serial.flush();
+        uart_putc(c);
     }
 }
 
-void execute_synchronized_capture() {
-    unsigned long valve_time = get_valve_open_time_ms();
-    unsigned long shutter_time = get_valve_to_shutter_time_ms();
-    bool schedule_from_valve_open = (get_valve_shutter_reference() == MenuItemChoiceIdShutterReleasesAfterValveOpen);
-    
-    if (schedule_from_valve_open) {
-        if (shutter_time < valve_time) {
-            shutter_time = 0;
-        } else {
-            shutter_time -= valve_time;
-        }
-    }
-    
-    Relay &valve = relay(RelayIndexValve);
-    Relay &shutter_cue = relay(RelayIndexCueShutter);
-    Relay &shutter_release = relay(RelayIndexReleaseShutter);
-    
-    shutter_cue.close();
-
-    delay(ShutterPrepareTimeMillis);
-    
-    valve.close();
-    delay(valve_time);
-    valve.open();
-
-    delay(shutter_time);
-    shutter_release.close();
-
-    delay(ShutterReleaseTimeMillis);
-    
-    shutter_release.open();
-    shutter_cue.open();
+// Print a report the user asked for over serial.  It's allowed to wait
+// for room in the output buffer rather than lose the end of it.
+static void print_report(void (*report)()) {
+    uart_set_wait_when_full(true);
+    report();
+    uart_set_wait_when_full(false);
 }
 
 void run(void) {
     setup_led();
     
-    Serial.begin(9600);
+    uart_begin(Serial_baud);
     init_printf(NULL, serial_putc);
 
     set_led(false);
@@ -120,45 +112,142 @@ void run(void) {
  
     lcd.backlight();
     lcd.clear();
+
+    LcdFrameBuffer display(lcd);
     
     Joypad jp;
     jp.start_listening();
 
+    CaptureEngine capture;
+    CaptureController controller(display, capture);
+
     while (!jp.input_ready);
     if (jp.get_held().key_select()) {
+        settings_clear();
 
-        lcd.print("EEPROM cleared");
+        LcdLine line;
+        line.append_P(PSTR("EEPROM cleared"));
+        display.set_line(0, line.get_text());
+        display.flush();
         while (jp.get_held().key_select());
     }
     
-    Menu &menu = build_menu(lcd);
+    Menu &menu = build_menu(display);
+    settings_restore(menu);
     menu.redraw(true);
 
     /*
-     * Ideally, we would clear interrupts (or at least some
-     * interrupts) while processing parts of the interrupt results,
-     * and then put the CPU to sleep with interrupts back on.  That
-     * way we can definitively avoid potential sychronization issues,
-     * and respond to interrupts with a consistent response time
-     * (which is not necessarily important right now).
-     *
-     * We can't disable interrupts altogether, because Arduino delay()
-     * calls use a timer interrupt, and the LCD module depends on it.
+     * The loop handles whatever the interrupts have left for it and
+     * then puts the CPU into idle sleep until the next interrupt.
+     * Everything it waits on arrives by interrupt: joypad reads
+     * (Timer3), serial, the TWI queue draining, capture edges
+     * (Timer5), and the millis tick (Timer0), which paces the capture
+     * controller and key auto-repeat.  Idle mode keeps all of those
+     * clocks running.
      *
-     * We should actually disable the specific interrupts selectively.
-     * I'll do that eventually, but for now the code is changing so
-     * much that it's not really worthwhile.
-     */    
+     * We check the key queue with interrupts off and only turn them
+     * back on right before sleeping, so a key that arrives after the
+     * check still wakes us: the instruction after sei() always runs
+     * before any pending interrupt, so sleep_cpu() can't miss it.
+     */
+    set_sleep_mode(SLEEP_MODE_IDLE);
 
     for(;;) {
-        KeyState pressed = menu.process_keys(jp);
+        // Key events are handled one at a time, in the order they
+        // happened.  The controller counts as busy as soon as START is
+        // requested, so a START followed by B aborts the capture it
+        // just started.
+        KeyEvent event;
+        while (jp.next_event(event)) {
+            if (!event.repeat) {
+                log_trace(LogKeyEvent, event.key, event.down ? 'D' : 'U', event.time_us);
+            }
+
+            if (!event.down) {
+                // Manual relay control acts when a key is let go, so
+                // items get to see the new held keys with no press
+                if (!controller.is_busy()) {
+                    menu.process_keys(KeyState(0), event.get_held());
+                }
+                continue;
+            }
+
+            KeyState pressed = event.get_key();
+
+            if (!event.repeat) {
+                latency_record(LatencyKeyDispatch, micros() - event.time_us);
+            }
+
+            if (controller.is_busy()) {
+                // The menu is locked while a capture runs or is
+                // waiting to; B aborts, and START queues another
+                // capture.
+                if (event.repeat) {
+                    continue;
+                }
+
+                if (pressed.key_b()) {
+                    controller.abort();
+                    menu.redraw(true);
+                } else if (pressed.key_start()) {
+                    controller.request_start();
+                }
+            } else {
+                menu.process_keys(pressed, event.get_held(), event.repeat);
+
+                if (pressed.key_start()) {
+                    // Only trace presses that start a capture straight
+                    // away, not ones queued behind a running capture
+                    latency_begin(event.time_us);
+                    controller.request_start();
+                }
+            }
+        }
+
+        if (!controller.is_busy()) {
+            menu.redraw();
+        }
 
-        if (pressed.key_start()) {
-            lcd.clear();
-            lcd.print("  Capturing...  ");
-            execute_synchronized_capture();
+        // Serial commands: 'l' prints the latency histograms, 'L'
+        // clears them, 'e' prints the edge timings of the last few
+        // captures, 'd' says how much log output was dropped, and 'b'
+        // (if built in) times the printf number conversions.
+        while (uart_available()) {
+            switch (uart_read()) {
+            case 'e':
+                print_report(edge_recorder_dump);
+                break;
+            case 'l':
+                print_report(latency_dump);
+                break;
+            case 'd':
+                dprintf("Serial: %u bytes dropped\n", uart_get_dropped());
+                break;
+            case 'L':
+                latency_reset();
+                dprintf("Latency cleared\n");
+                break;
+#ifdef PRINTF_BENCHMARK
+            case 'b':
+                print_report(tfp_benchmark);
+                break;
+#endif
+            }
+        }
+
+        if (controller.tick()) {
             menu.redraw(true);
         }
+
+        settings_tick(menu, controller.is_busy());
+
+        cli();
+        if (!jp.has_events()) {
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+        }
+        sei();
     }
 }
-
@@ -0,0 +1,367 @@
+#include "settings.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+#include "Arduino.h"
+
+#include "log.h"
+#include "printf.h"
+
+// The settings log takes the first 3 KB of EEPROM, and the preset
+// slots the last 1 KB.
+static uint16_t const Settings_slot_size = 128;
+static uint8_t const Settings_num_slots = 24;
+
+uint8_t const SettingsMaxPresets = 8;
+
+// Slot header:
+//   0-3  sequence number, higher is newer
+//   4-5  menu state layout (see Menu::get_state_layout)
+//   6    payload length
+//   7    reserved, 0
+//   8-9  CRC-16 over bytes 0-7 and the payload
+static uint8_t const Settings_header_size = 10;
+static uint8_t const Settings_header_crc = 8;
+
+static uint8_t const Settings_max_payload = Settings_slot_size - Settings_header_size;
+
+// Order to write the slot header in, after the payload.  The sequence
+// number goes last so a slot never looks newer until the rest of it is
+// in place.
+static uint8_t const settings_header_write_order[Settings_header_size] = {
+    4, 5, 6, 7, 8, 9, 0, 1, 2, 3
+};
+
+// Wait this long after the last change before saving, so scrolling
+// through values doesn't write every step.
+static unsigned long const Settings_save_delay_ms = 3000;
+
+static uint8_t const Settings_no_slot = 0xff;
+
+static uint8_t settings_newest_slot = Settings_no_slot;
+static unsigned long settings_newest_seq = 0;
+
+static uint16_t settings_seen_changes = 0;
+static bool settings_dirty = false;
+static unsigned long settings_changed_ms = 0;
+
+// Save in progress: the whole slot image, and how far through writing
+// it we are (Settings_no_slot when not saving).
+static uint8_t settings_image[Settings_slot_size];
+static uint8_t settings_write_slot = Settings_no_slot;
+static uint8_t settings_write_step = 0;
+static uint8_t settings_write_len = 0;
+static bool settings_write_is_log = false;
+
+// A preset save waiting for the preset write in progress: its image,
+// taken when it was asked for, and which preset it's for
+// (Settings_no_slot when there isn't one).
+static uint8_t settings_pending_image[Settings_slot_size];
+static uint8_t settings_pending_preset = Settings_no_slot;
+
+static uint8_t *slot_address(uint8_t slot, uint8_t offset) {
+    return (uint8_t *)(slot * Settings_slot_size + offset);
+}
+
+static unsigned long read_slot_seq(uint8_t slot) {
+    unsigned long seq = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        seq |= (unsigned long)eeprom_read_byte(slot_address(slot, i)) << (8 * i);
+    }
+    return seq;
+}
+
+// Check a slot's header and CRC against what the menu expects.
+static bool slot_is_valid(uint8_t slot, uint16_t layout, uint8_t len) {
+    uint8_t header[Settings_header_size];
+    eeprom_read_block(header, slot_address(slot, 0), Settings_header_size);
+
+    if (header[4] != (layout & 0xff) || header[5] != (layout >> 8) || header[6] != len) {
+        return false;
+    }
+
+    uint16_t crc = 0xffff;
+    for (uint8_t i = 0; i < Settings_header_crc; i++) {
+        crc = _crc16_update(crc, header[i]);
+    }
+    for (uint8_t i = 0; i < len; i++) {
+        crc = _crc16_update(crc, eeprom_read_byte(slot_address(slot, Settings_header_size + i)));
+    }
+
+    return header[8] == (crc & 0xff) && header[9] == (crc >> 8);
+}
+
+bool settings_restore(Menu &menu) {
+    uint16_t layout = menu.get_state_layout();
+    uint8_t len = menu.get_state_size();
+
+    if (len > Settings_max_payload) {
+        dprintf("Settings don't fit in a slot (%u bytes)\n", len);
+        return false;
+    }
+
+    // Try slots newest first until one checks out.  Usually that's the
+    // first one, so this reads the headers once and one payload.
+    // Erased slots have a sequence number of 0xffffffff, so never
+    // qualify.
+    unsigned long below = 0xffffffff;
+    for (;;) {
+        uint8_t best = Settings_no_slot;
+        unsigned long best_seq = 0;
+
+        for (uint8_t slot = 0; slot < Settings_num_slots; slot++) {
+            unsigned long seq = read_slot_seq(slot);
+            if (seq < below && (best == Settings_no_slot || seq > best_seq)) {
+                best = slot;
+                best_seq = seq;
+            }
+        }
+
+        if (best == Settings_no_slot) {
+            dprintf("No saved settings\n");
+            return false;
+        }
+
+        if (slot_is_valid(best, layout, len)) {
+            uint8_t payload[Settings_max_payload];
+            eeprom_read_block(payload, slot_address(best, Settings_header_size), len);
+            menu.load_state(payload);
+
+            // Loading isn't a change worth saving
+            settings_seen_changes = menu.get_change_count();
+
+            settings_newest_slot = best;
+            settings_newest_seq = best_seq;
+
+            dprintf("Settings restored from slot %u\n", best);
+            return true;
+        }
+
+        below = best_seq;
+    }
+}
+
+void settings_clear() {
+    // Make every slot look erased, so sequence numbers start again
+    // from scratch without old ones getting in the way.  That goes for
+    // the preset slots too: their CRC covers the sequence number, so
+    // they stop checking out.
+    for (uint8_t slot = 0; slot < Settings_num_slots + SettingsMaxPresets; slot++) {
+        for (uint8_t i = 0; i < 4; i++) {
+            eeprom_update_byte(slot_address(slot, i), 0xff);
+        }
+    }
+
+    settings_newest_slot = Settings_no_slot;
+    settings_newest_seq = 0;
+    settings_pending_preset = Settings_no_slot;
+}
+
+// Whether the menu state in the image matches the newest saved copy.
+static bool image_matches_newest(uint16_t layout, uint8_t len) {
+    if (settings_newest_slot == Settings_no_slot || !slot_is_valid(settings_newest_slot, layout, len)) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t saved = eeprom_read_byte(slot_address(settings_newest_slot, Settings_header_size + i));
+        if (saved != settings_image[Settings_header_size + i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Fill in a slot image from the menu, with the given sequence
+// number.
+static void build_image(uint8_t *image, Menu &menu, unsigned long seq, uint16_t layout, uint8_t len) {
+    menu.save_state(&image[Settings_header_size]);
+
+    image[0] = seq;
+    image[1] = seq >> 8;
+    image[2] = seq >> 16;
+    image[3] = seq >> 24;
+    image[4] = layout;
+    image[5] = layout >> 8;
+    image[6] = len;
+    image[7] = 0;
+
+    uint16_t crc = 0xffff;
+    for (uint8_t i = 0; i < Settings_header_crc; i++) {
+        crc = _crc16_update(crc, image[i]);
+    }
+    for (uint8_t i = 0; i < len; i++) {
+        crc = _crc16_update(crc, image[Settings_header_size + i]);
+    }
+    image[8] = crc;
+    image[9] = crc >> 8;
+}
+
+static void begin_save(Menu &menu) {
+    uint16_t layout = menu.get_state_layout();
+    uint8_t len = menu.get_state_size();
+
+    if (len > Settings_max_payload) {
+        return;
+    }
+
+    build_image(settings_image, menu, settings_newest_seq + 1, layout, len);
+
+    if (image_matches_newest(layout, len)) {
+        return;
+    }
+
+    settings_write_slot = (settings_newest_slot == Settings_no_slot) ? 0 : (settings_newest_slot + 1) % Settings_num_slots;
+    settings_write_step = 0;
+    settings_write_len = len;
+    settings_write_is_log = true;
+}
+
+// Write the next byte of the save in progress, if the EEPROM is ready
+// for it.
+static void continue_save() {
+    if (!eeprom_is_ready()) {
+        return;
+    }
+
+    uint8_t offset;
+    if (settings_write_step < settings_write_len) {
+        offset = Settings_header_size + settings_write_step;
+    } else {
+        offset = settings_header_write_order[settings_write_step - settings_write_len];
+    }
+
+    eeprom_update_byte(slot_address(settings_write_slot, offset), settings_image[offset]);
+    settings_write_step++;
+
+    if (settings_write_step == settings_write_len + Settings_header_size) {
+        if (settings_write_is_log) {
+            settings_newest_slot = settings_write_slot;
+            settings_newest_seq++;
+        }
+
+        log_event(LogSettingsSaved, settings_write_slot);
+        settings_write_slot = Settings_no_slot;
+    }
+}
+
+// Finish off any save in progress right away.
+static void finish_save() {
+    while (settings_write_slot != Settings_no_slot) {
+        continue_save();
+    }
+}
+
+bool settings_load_preset(Menu &menu, uint8_t preset) {
+    uint16_t layout = menu.get_state_layout();
+    uint8_t len = menu.get_state_size();
+    uint8_t slot = Settings_num_slots + preset;
+
+    if (preset >= SettingsMaxPresets || len > Settings_max_payload) {
+        return false;
+    }
+
+    // A save of this preset that isn't all in EEPROM yet has the
+    // newest copy; don't read a slot that's still being written
+    if (settings_pending_preset == preset) {
+        menu.load_state(&settings_pending_image[Settings_header_size]);
+        return true;
+    }
+
+    if (settings_write_slot == slot) {
+        menu.load_state(&settings_image[Settings_header_size]);
+        return true;
+    }
+
+    if (!slot_is_valid(slot, layout, len)) {
+        return false;
+    }
+
+    uint8_t payload[Settings_max_payload];
+    eeprom_read_block(payload, slot_address(slot, Settings_header_size), len);
+    menu.load_state(payload);
+
+    return true;
+}
+
+// Start writing the preset image in settings_image.
+static void begin_preset_write(uint8_t preset) {
+    settings_write_slot = Settings_num_slots + preset;
+    settings_write_step = 0;
+    settings_write_len = settings_image[6];
+    settings_write_is_log = false;
+}
+
+static void begin_pending_preset_write() {
+    memcpy(settings_image, settings_pending_image, Settings_slot_size);
+    begin_preset_write(settings_pending_preset);
+    settings_pending_preset = Settings_no_slot;
+}
+
+void settings_save_preset(Menu &menu, uint8_t preset) {
+    uint16_t layout = menu.get_state_layout();
+    uint8_t len = menu.get_state_size();
+
+    if (preset >= SettingsMaxPresets || len > Settings_max_payload) {
+        return;
+    }
+
+    // A log save can always be made again later, so a preset takes the
+    // image buffer from it.  The part already written fails its CRC,
+    // the same as a save cut off by a power failure.
+    if (settings_write_slot != Settings_no_slot && settings_write_is_log) {
+        settings_write_slot = Settings_no_slot;
+        settings_dirty = true;
+    }
+
+    // Presets aren't part of the log, so their sequence number is
+    // unused
+    if (settings_write_slot == Settings_no_slot) {
+        build_image(settings_image, menu, 0, layout, len);
+        begin_preset_write(preset);
+        return;
+    }
+
+    // Another preset is being written; take the settings now and write
+    // them after it.  Only a third save in quick succession has to
+    // wait here for the EEPROM.
+    if (settings_pending_preset != Settings_no_slot && settings_pending_preset != preset) {
+        finish_save();
+        begin_pending_preset_write();
+    }
+
+    build_image(settings_pending_image, menu, 0, layout, len);
+    settings_pending_preset = preset;
+}
+
+void settings_tick(Menu &menu, bool busy) {
+    if (menu.get_change_count() != settings_seen_changes) {
+        settings_seen_changes = menu.get_change_count();
+        settings_dirty = true;
+        settings_changed_ms = millis();
+    }
+
+    if (busy) {
+        return;
+    }
+
+    if (settings_write_slot != Settings_no_slot) {
+        continue_save();
+        return;
+    }
+
+    if (settings_pending_preset != Settings_no_slot) {
+        begin_pending_preset_write();
+        return;
+    }
+
+    if (settings_dirty && millis() - settings_changed_ms >= Settings_save_delay_ms) {
+        settings_dirty = false;
+        begin_save(menu);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef SETTINGS_H_
+#define SETTINGS_H_
+
+#include <stdint.h>
+
+#include "menu.h"
+
+/*
+ * Persistent menu settings in EEPROM.
+ *
+ * The settings area is split into fixed-size slots, and every save
+ * goes into the slot after the newest one, so writes are spread
+ * evenly over the whole area.  Each slot starts with a small header
+ * (sequence number, menu layout, length and a CRC over the lot), so
+ * finding the newest good copy at boot only means reading the
+ * headers, plus one payload to check its CRC.  If a save was cut off
+ * by a power failure, its CRC won't match and we fall back to the
+ * copy before it.
+ *
+ * Saves happen in the background from settings_tick(), one byte at a
+ * time as the EEPROM becomes ready, a few seconds after the last
+ * change, and only if the settings actually differ from the newest
+ * saved copy.
+ *
+ * Presets live in their own fixed slots after the log, in the same
+ * format, and are only written when asked to.
+ */
+
+// Number of preset slots in EEPROM.
+extern uint8_t const SettingsMaxPresets;
+
+// Load the newest saved settings into the menu.  Returns false (and
+// leaves the defaults) if there are none, or they were saved by a
+// menu with different items.
+bool settings_restore(Menu &menu);
+
+// Throw away every saved copy, presets included.  Blocks until done.
+void settings_clear();
+
+// Load a preset saved with settings_save_preset() into the menu,
+// including a save that hasn't finished being written.  Returns false
+// if that slot has never been saved (or was saved by a different menu
+// layout).
+bool settings_load_preset(Menu &menu, uint8_t preset);
+
+// Save the menu's current settings into a preset slot.  The settings
+// are taken straight away and written in the background from
+// settings_tick(), ahead of any settings log save.
+void settings_save_preset(Menu &menu, uint8_t preset);
+
+// Call from the main loop.  Notices menu changes and writes them out
+// once things have been quiet for a while; nothing is written while
+// busy (eg. capturing).
+void settings_tick(Menu &menu, bool busy);
+
+#endif
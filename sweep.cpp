@@ -0,0 +1,76 @@
+#include "sweep.h"
+
+#include <stdint.h>
+
+//
+// SweepRange implementation
+//
+
+uint16_t SweepRange::get_num_values() const {
+    if (step == 0) {
+        return 1;
+    }
+
+    unsigned long span = (stop > start) ? (stop - start) : (start - stop);
+    unsigned long count = span / step;
+    return (count < SweepMaxCount) ? count + 1 : SweepMaxCount;
+}
+
+unsigned long SweepRange::get_value(uint16_t index) const {
+    if (stop >= start) {
+        return start + index * step;
+    } else {
+        return start - index * step;
+    }
+}
+
+//
+// Sweep class implementation
+//
+
+void Sweep::set_open_time(unsigned long fixed_ms) {
+    _sweep_open_time = false;
+    _open_time_fixed = fixed_ms;
+}
+
+void Sweep::set_open_time(SweepRange const &range) {
+    _sweep_open_time = true;
+    _open_time_range = range;
+}
+
+void Sweep::set_shutter_time(unsigned long fixed_ms) {
+    _sweep_shutter_time = false;
+    _shutter_time_fixed = fixed_ms;
+}
+
+void Sweep::set_shutter_time(SweepRange const &range) {
+    _sweep_shutter_time = true;
+    _shutter_time_range = range;
+}
+
+uint16_t Sweep::get_num_shutter_times() const {
+    return _sweep_shutter_time ? _shutter_time_range.get_num_values() : 1;
+}
+
+uint16_t Sweep::get_num_shots() const {
+    unsigned long open_times = _sweep_open_time ? _open_time_range.get_num_values() : 1;
+    unsigned long shots = open_times * get_num_shutter_times();
+    return (shots < SweepMaxCount) ? shots : SweepMaxCount;
+}
+
+// The shutter time is the inner loop: for each open time we step
+// through every shutter time.
+
+unsigned long Sweep::get_open_time() const {
+    if (!_sweep_open_time) {
+        return _open_time_fixed;
+    }
+    return _open_time_range.get_value(_shot / get_num_shutter_times());
+}
+
+unsigned long Sweep::get_shutter_time() const {
+    if (!_sweep_shutter_time) {
+        return _shutter_time_fixed;
+    }
+    return _shutter_time_range.get_value(_shot % get_num_shutter_times());
+}
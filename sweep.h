@@ -0,0 +1,80 @@
+#ifndef SWEEP_H_
+#define SWEEP_H_
+
+#include <stdint.h>
+
+// Most values in a range, and most shots in a sweep; anything bigger
+// is cut short here rather than wrapping around.  At even a second a
+// shot, that's most of a day.
+static uint16_t const SweepMaxCount = 0xffff;
+
+// A range of times to step through.  stop may be below start, in
+// which case we step downwards; both ends are included.
+struct SweepRange {
+    unsigned long start;
+    unsigned long stop;
+    unsigned long step;
+
+    uint16_t get_num_values() const;
+    unsigned long get_value(uint16_t index) const;
+};
+
+// Steps through every combination of valve open time and valve to
+// shutter time for a bracketing run.  A parameter that isn't being
+// swept stays at the value it was given.
+class Sweep {
+
+public:
+
+    Sweep() : _sweep_open_time(false),
+              _sweep_shutter_time(false),
+              _open_time_fixed(0),
+              _shutter_time_fixed(0),
+              _shot(0) {}
+
+    void set_open_time(unsigned long fixed_ms);
+    void set_open_time(SweepRange const &range);
+    void set_shutter_time(unsigned long fixed_ms);
+    void set_shutter_time(SweepRange const &range);
+
+    // Rewind to the first shot.
+    void rewind() {
+        _shot = 0;
+    }
+
+    // Every combination of the two ranges, up to SweepMaxCount.
+    uint16_t get_num_shots() const;
+
+    // Current shot, counting from 0.
+    inline uint16_t get_shot() const {
+        return _shot;
+    }
+
+    inline bool is_finished() const {
+        return _shot >= get_num_shots();
+    }
+
+    unsigned long get_open_time() const;
+    unsigned long get_shutter_time() const;
+
+    inline void advance() {
+        _shot++;
+    }
+
+private:
+
+    uint16_t get_num_shutter_times() const;
+
+    bool _sweep_open_time;
+    bool _sweep_shutter_time;
+
+    SweepRange _open_time_range;
+    SweepRange _shutter_time_range;
+
+    unsigned long _open_time_fixed;
+    unsigned long _shutter_time_fixed;
+
+    uint16_t _shot;
+};
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * Turns the serial output of a LOG_BINARY build (see log.h) back into
+ * text.  Plain text passes straight through; binary records are
+ * formatted with the same table the firmware was built with, so
+ * rebuild this whenever log_formats.h changes.
+ *
+ * Build, from the top of the tree:
+ *
+ *     g++ -o log_decode tools/log_decode.cpp -I.
+ *
+ * Use:
+ *
+ *     stty -F /dev/ttyACM0 9600 raw
+ *     ./log_decode < /dev/ttyACM0
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "log_formats.h"
+
+// log.h and log.cpp pull in AVR headers, so these are repeated here.
+static int const Record_marker = 0x80;
+static int const Max_arg_bytes = 15;
+
+struct LogFormat {
+    char const *name;
+    char const *args;
+    char const *format;
+};
+
+static LogFormat const log_formats[] = {
+#define LOG_FORMAT(name, args, format) { #name, args, format },
+    LOG_FORMATS
+#undef LOG_FORMAT
+};
+
+static int const Num_formats = sizeof(log_formats) / sizeof(log_formats[0]);
+
+// Walk a format string the way tfp_format does, calling conversion()
+// for each directive with its type character and whether it had the
+// 'l' modifier.  Stops and returns false as soon as conversion() does.
+template <typename Conversion>
+static bool for_each_conversion(char const *format, Conversion conversion) {
+    for (char const *p = format; *p; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        p++;
+
+        if (*p == '%') {
+            continue;
+        }
+
+        while (*p == '0' || (*p >= '1' && *p <= '9')) {
+            p++;
+        }
+
+        bool is_long = false;
+        if (*p == 'l') {
+            is_long = true;
+            p++;
+        }
+
+        if (!*p || !conversion(p, is_long)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Check that each message's args agree with its format, so that the
+// decoder can't silently get out of step with a record.
+static bool check_formats() {
+    bool ok = true;
+
+    for (int id = 0; id < Num_formats; id++) {
+        LogFormat const &f = log_formats[id];
+        char const *arg = f.args;
+
+        bool matches = for_each_conversion(f.format, [&](char const *p, bool is_long) {
+            char size = *arg++;
+
+            switch (*p) {
+            case 'c':
+                return !is_long && size == '1';
+            case 'k':
+                return size == '4';
+            case 'u':
+            case 'd':
+            case 'x':
+            case 'X':
+                return is_long ? size == '4' : (size == '1' || size == '2');
+            default:
+                // Including %s: there's no string in a record
+                return false;
+            }
+        });
+
+        if (!matches || *arg) {
+            fprintf(stderr, "log_decode: format %s doesn't match its args \"%s\"\n",
+                    f.name, f.args);
+            ok = false;
+        }
+
+        int bytes = 0;
+        for (arg = f.args; *arg; arg++) {
+            bytes += *arg - '0';
+        }
+
+        if (bytes > Max_arg_bytes) {
+            fprintf(stderr, "log_decode: format %s has more than %d bytes of args\n",
+                    f.name, Max_arg_bytes);
+            ok = false;
+        }
+    }
+
+    if (Num_formats > 0x7f) {
+        fprintf(stderr, "log_decode: too many formats for a one-byte record id\n");
+        ok = false;
+    }
+
+    return ok;
+}
+
+// Read an argument of the given size, little-endian as the AVR stores
+// it.  Returns false at end of input.
+static bool read_arg(char size, unsigned long &value) {
+    int bytes = size - '0';
+    value = 0;
+
+    for (int i = 0; i < bytes; i++) {
+        int c = getchar();
+        if (c == EOF) {
+            return false;
+        }
+        value |= (unsigned long)(c & 0xff) << (8 * i);
+    }
+
+    return true;
+}
+
+// Sign-extend an AVR int (or char, or long) of the given size.
+static long to_signed(unsigned long value, char size) {
+    int bits = 8 * (size - '0');
+    unsigned long sign = 1UL << (bits - 1);
+
+    value &= (sign << 1) - 1;
+    return (long)(value ^ sign) - (long)sign;
+}
+
+static bool decode_record(int id) {
+    if (id >= Num_formats) {
+        printf("<unknown record %d>\n", id);
+        return true;
+    }
+
+    LogFormat const &f = log_formats[id];
+    unsigned long values[Max_arg_bytes];
+    int num_values = 0;
+
+    for (char const *arg = f.args; *arg; arg++) {
+        if (!read_arg(*arg, values[num_values++])) {
+            return false;
+        }
+    }
+
+    // Print the format a directive at a time, handing each one to the
+    // host printf with the argument widened to a host type.
+    char const *p = f.format;
+    int index = 0;
+
+    while (*p) {
+        if (*p != '%') {
+            putchar(*p++);
+            continue;
+        }
+
+        if (p[1] == '%') {
+            putchar('%');
+            p += 2;
+            continue;
+        }
+
+        // Copy the directive without any 'l'; we always pass a long
+        char spec[16] = "%";
+        size_t len = 1;
+        p++;
+        while (*p == '0' || (*p >= '1' && *p <= '9')) {
+            if (len < sizeof(spec) - 4) {
+                spec[len++] = *p;
+            }
+            p++;
+        }
+        if (*p == 'l') {
+            p++;
+        }
+
+        char size = f.args[index];
+        unsigned long value = values[index];
+        index++;
+
+        if (*p == 'c') {
+            spec[len++] = 'c';
+            printf(spec, (int)(value & 0xff));
+        } else if (*p == 'k') {
+            // Thousandths, with the point; the width covers the lot
+            char fixed[24];
+            snprintf(fixed, sizeof(fixed), "%lu.%03lu", value / 1000, value % 1000);
+            spec[len++] = 's';
+            printf(spec, fixed);
+        } else if (*p == 'd') {
+            spec[len++] = 'l';
+            spec[len++] = 'd';
+            printf(spec, to_signed(value, size));
+        } else {
+            spec[len++] = 'l';
+            spec[len++] = *p;
+            printf(spec, value);
+        }
+        p++;
+    }
+
+    return true;
+}
+
+int main() {
+    if (!check_formats()) {
+        return 1;
+    }
+
+    int c;
+    while ((c = getchar()) != EOF) {
+        if (c < Record_marker) {
+            putchar(c);
+        } else if (!decode_record(c - Record_marker)) {
+            break;
+        }
+
+        if (c == '\n' || c >= Record_marker) {
+            fflush(stdout);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "twi_queue.h"
+
+#include <stdint.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <util/twi.h>
+
+static unsigned long const Twi_frequency = 100000;
+
+// 8 data bits plus the acknowledge bit
+uint8_t const TwiQueueByteTimeMicros = 9 * (1000000 / Twi_frequency);
+
+// Indices are uint8_t so they wrap around the 256-byte buffer for free.
+static uint8_t volatile twi_buf[256];
+static volatile uint8_t twi_head = 0;   // written by the producer
+static volatile uint8_t twi_tail = 0;   // written by the ISR
+static volatile bool twi_busy = false;
+static volatile uint16_t twi_errors = 0;
+
+static uint8_t twi_address = 0;
+
+static inline void twi_start_if_idle() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (!twi_busy && twi_head != twi_tail) {
+            // Let a STOP from the last transfer finish first
+            while (TWCR & _BV(TWSTO));
+
+            twi_busy = true;
+            TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+        }
+    }
+}
+
+static inline void twi_put(uint8_t value) {
+    while ((uint8_t)(twi_head + 1) == twi_tail) {
+        // Full; make sure the ISR is draining it
+        twi_start_if_idle();
+    }
+
+    twi_buf[twi_head] = value;
+    twi_head++;
+}
+
+void twi_queue_begin(uint8_t address) {
+    twi_address = address;
+
+    // Internal pull-ups on SCL (PD0) and SDA (PD1), like Wire.  The
+    // relays share PORTD.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        PORTD |= _BV(PD0) | _BV(PD1);
+    }
+
+    // Prescaler 1; SCL = F_CPU / (16 + 2 * TWBR)
+    TWSR = 0;
+    TWBR = ((F_CPU / Twi_frequency) - 16) / 2;
+
+    TWCR = _BV(TWEN);
+}
+
+void twi_queue_push(uint8_t const *buf, uint8_t len) {
+    while (len--) {
+        twi_put(*buf++);
+    }
+    twi_start_if_idle();
+}
+
+void twi_queue_repeat(uint8_t value, uint8_t count) {
+    while (count--) {
+        twi_put(value);
+    }
+    twi_start_if_idle();
+}
+
+void twi_queue_flush() {
+    while (twi_busy || twi_head != twi_tail) {
+        twi_start_if_idle();
+    }
+    while (TWCR & _BV(TWSTO));
+}
+
+uint16_t twi_queue_get_errors() {
+    uint16_t errors;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        errors = twi_errors;
+    }
+    return errors;
+}
+
+ISR(TWI_vect) {
+    switch (TW_STATUS) {
+
+    case TW_START:
+    case TW_REP_START:
+        TWDR = (twi_address << 1) | TW_WRITE;
+        TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        break;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+        if (twi_tail != twi_head) {
+            TWDR = twi_buf[twi_tail];
+            twi_tail++;
+            TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        } else {
+            TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+            twi_busy = false;
+        }
+        break;
+
+    default:
+        // NACK or lost arbitration.  Drop whatever is queued rather
+        // than retrying forever.
+        twi_errors++;
+        twi_tail = twi_head;
+        TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+        twi_busy = false;
+        break;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef TWI_QUEUE_H_
+#define TWI_QUEUE_H_
+
+#include <stdint.h>
+
+/*
+ * Interrupt-driven I2C output to a single slave (the LCD's port
+ * expander).  Bytes are queued into a ring buffer and streamed out
+ * from the TWI interrupt as one long write transaction, which is
+ * closed with a STOP whenever the queue runs dry.  Callers only block
+ * if the ring buffer is full.
+ *
+ * This replaces the Wire library, which owns the TWI interrupt; the
+ * two can't be linked together.
+ */
+
+// Set up the TWI hardware at 100 kHz to talk to the given 7-bit
+// address.
+void twi_queue_begin(uint8_t address);
+
+// Queue bytes for sending.  Waits for room if the queue is full, so
+// must not be called with interrupts disabled.
+void twi_queue_push(uint8_t const *buf, uint8_t len);
+
+// Queue the same byte count times.  Each byte holds the bus for nine
+// SCL periods, which makes this a way to wait out slow LCD commands
+// without blocking the CPU.
+void twi_queue_repeat(uint8_t value, uint8_t count);
+
+// Time one byte occupies the bus, in microseconds.
+extern uint8_t const TwiQueueByteTimeMicros;
+
+// Wait until everything queued has been sent and the bus is released.
+void twi_queue_flush();
+
+// Transfers abandoned because the slave didn't acknowledge (or we
+// lost arbitration).
+uint16_t twi_queue_get_errors();
+
+#endif
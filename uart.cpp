@@ -0,0 +1,137 @@
+#include "uart.h"
+
+#include <stdint.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+
+// Indices are uint8_t so they wrap around the 256-byte buffer for free.
+static uint8_t volatile uart_tx_buf[256];
+static volatile uint8_t uart_tx_head = 0;   // written by uart_putc
+static volatile uint8_t uart_tx_tail = 0;   // written by the ISR
+
+// Must be a power of two.
+static uint8_t const Uart_rx_size = 32;
+static uint8_t volatile uart_rx_buf[Uart_rx_size];
+static volatile uint8_t uart_rx_head = 0;   // written by the ISR
+static volatile uint8_t uart_rx_tail = 0;   // written by uart_read
+
+static volatile uint16_t uart_dropped = 0;
+static volatile bool uart_written = false;
+static bool uart_wait_when_full = false;
+
+static inline void enable_udre_interrupt() {
+    UCSR0B |= _BV(UDRIE0);
+}
+
+static inline void disable_udre_interrupt() {
+    UCSR0B &= ~_BV(UDRIE0);
+}
+
+void uart_begin(unsigned long baud) {
+    // Double speed mode, which gets closer to the common baud rates
+    // at 16 MHz
+    UCSR0A = _BV(U2X0);
+    UBRR0 = (F_CPU / 4 / baud - 1) / 2;
+
+    // 8 data bits, no parity, 1 stop bit
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+
+    UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+void uart_putc(uint8_t c) {
+    uart_write(&c, 1);
+}
+
+bool uart_write(uint8_t const *data, uint8_t len) {
+    for (;;) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            uint8_t head = uart_tx_head;
+            uint8_t room = uart_tx_tail - head - 1;
+
+            if (len <= room) {
+                for (uint8_t i = 0; i < len; i++) {
+                    uart_tx_buf[head++] = data[i];
+                }
+                uart_tx_head = head;
+                enable_udre_interrupt();
+                return true;
+            }
+        }
+
+        // Full.  Only wait if the interrupt can make room.
+        if (!uart_wait_when_full || !(SREG & _BV(SREG_I))) {
+            uart_dropped += len;
+            return false;
+        }
+    }
+}
+
+void uart_set_wait_when_full(bool wait) {
+    uart_wait_when_full = wait;
+}
+
+uint16_t uart_get_dropped() {
+    uint16_t dropped;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        dropped = uart_dropped;
+    }
+    return dropped;
+}
+
+void uart_flush() {
+    if (!uart_written) {
+        return;
+    }
+
+    while (uart_tx_head != uart_tx_tail);
+
+    // The last byte may still be shifting out; TXC is set once it's
+    // gone (the ISR cleared it when loading the byte)
+    while (!(UCSR0A & _BV(TXC0)));
+}
+
+uint8_t uart_available() {
+    return (uart_rx_head - uart_rx_tail) & (Uart_rx_size - 1);
+}
+
+int uart_read() {
+    uint8_t tail = uart_rx_tail;
+    if (tail == uart_rx_head) {
+        return -1;
+    }
+
+    uint8_t c = uart_rx_buf[tail];
+    uart_rx_tail = (tail + 1) & (Uart_rx_size - 1);
+    return c;
+}
+
+ISR(USART0_UDRE_vect) {
+    uint8_t tail = uart_tx_tail;
+
+    if (tail == uart_tx_head) {
+        disable_udre_interrupt();
+        return;
+    }
+
+    // Writing 1 clears TXC, so uart_flush can tell when this byte has
+    // gone.  The error flags must be written as 0.
+    UCSR0A = (UCSR0A & _BV(U2X0)) | _BV(TXC0);
+    UDR0 = uart_tx_buf[tail];
+    uart_tx_tail = tail + 1;
+    uart_written = true;
+}
+
+ISR(USART0_RX_vect) {
+    uint8_t c = UDR0;
+    uint8_t head = uart_rx_head;
+    uint8_t next = (head + 1) & (Uart_rx_size - 1);
+
+    // Drop bytes nobody's reading
+    if (next != uart_rx_tail) {
+        uart_rx_buf[head] = c;
+        uart_rx_head = next;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef UART_H_
+#define UART_H_
+
+#include <stdint.h>
+
+/*
+ * Interrupt-driven serial port on USART0 (the USB serial on the
+ * Arduino).
+ *
+ * Output goes into a RAM ring buffer that the data register empty
+ * interrupt drains, so printing costs a few cycles per character
+ * instead of a character time.  When the buffer is full, new bytes are
+ * dropped and counted (see uart_get_dropped), unless waiting has been
+ * turned on with uart_set_wait_when_full.  Received bytes go into a
+ * small ring buffer of their own.
+ *
+ * This replaces the Arduino Serial object, which owns the USART0
+ * interrupts; the two can't be linked together.
+ */
+
+// Set up USART0 for 8N1 at the given baud rate.
+void uart_begin(unsigned long baud);
+
+// Queue a byte for sending.  Never blocks unless waiting is turned on.
+void uart_putc(uint8_t c);
+
+// Queue len bytes as a unit: either they all go in the buffer, or
+// (when it's full and not waiting) none of them do and all len count
+// as dropped.  Returns whether they went in.
+bool uart_write(uint8_t const *data, uint8_t len);
+
+// Make uart_putc wait for room instead of dropping bytes, eg. while
+// printing a long report the user asked for.  Waiting is never done
+// with interrupts disabled; those bytes are still dropped.
+void uart_set_wait_when_full(bool wait);
+
+// Bytes thrown away because the output buffer was full.
+uint16_t uart_get_dropped();
+
+// Wait until everything queued has gone out on the wire.  For
+// shutdown paths, or before anything that would stop the interrupt
+// from draining the buffer.  Must not be called with interrupts
+// disabled.
+void uart_flush();
+
+// Number of received bytes waiting.
+uint8_t uart_available();
+
+// Take a received byte, or -1 if there are none.
+int uart_read();
+
+#endif
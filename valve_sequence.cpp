@@ -0,0 +1,68 @@
+#include "valve_sequence.h"
+
+#include <stdint.h>
+
+#include "constants.h"
+
+bool ValveSequence::add_pulse(unsigned long gap_ms, unsigned long open_ms) {
+    if (_num_pulses >= MaxPulses) {
+        return false;
+    }
+
+    _pulses[_num_pulses].gap_ms = gap_ms;
+    _pulses[_num_pulses].open_ms = open_ms;
+    _num_pulses++;
+
+    return true;
+}
+
+bool ValveSequence::compile(CaptureTimeline &timeline) const {
+    bool ok = true;
+
+    timeline.clear();
+
+    if (!has_shutter_reference()) {
+        return false;
+    }
+
+    unsigned long t_us = 0;
+
+    // Cue the camera first, and give it time to get ready
+    if (!_camera_cued) {
+        ok &= timeline.add_relay_edge(0, RelayIndexCueShutter, true);
+        t_us = ShutterPrepareTimeMillis * 1000;
+    }
+
+    unsigned long reference_us = t_us;
+
+    for (uint8_t i = 0; i < _num_pulses; i++) {
+        ValvePulse const &pulse = _pulses[i];
+
+        if (i > 0) {
+            t_us += pulse.gap_ms * 1000;
+        }
+
+        ok &= timeline.add_relay_edge(t_us, RelayIndexValve, true);
+        if (i == _shutter_pulse && _shutter_from_open) {
+            reference_us = t_us;
+        }
+
+        t_us += pulse.open_ms * 1000;
+
+        ok &= timeline.add_relay_edge(t_us, RelayIndexValve, false);
+        if (i == _shutter_pulse && !_shutter_from_open) {
+            reference_us = t_us;
+        }
+    }
+
+    unsigned long release_us = reference_us + _shutter_delay_ms * 1000;
+    unsigned long finish_us = release_us + ShutterReleaseTimeMillis * 1000;
+
+    ok &= timeline.add_relay_edge(release_us, RelayIndexReleaseShutter, true);
+    ok &= timeline.add_relay_edge(finish_us, RelayIndexReleaseShutter, false);
+    if (!_keep_cued) {
+        ok &= timeline.add_relay_edge(finish_us, RelayIndexCueShutter, false);
+    }
+
+    return ok;
+}
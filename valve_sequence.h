@@ -0,0 +1,101 @@
+#ifndef VALVE_SEQUENCE_H_
+#define VALVE_SEQUENCE_H_
+
+#include <stdint.h>
+
+#include "capture_timeline.h"
+
+struct ValvePulse {
+    // Time from the previous pulse closing the valve to this one
+    // opening it.  Ignored for the first pulse.
+    unsigned long gap_ms;
+
+    // Time the valve is held open.
+    unsigned long open_ms;
+};
+
+// A capture made of one or more valve pulses, with the shutter
+// released a fixed time after the opening or closing of one of them.
+class ValveSequence {
+
+public:
+
+    static uint8_t const MaxPulses = 4;
+
+    // A shutter reference that isn't any pulse in the sequence.
+    static uint8_t const NoPulse = 0xff;
+
+    ValveSequence() : _num_pulses(0),
+                      _shutter_pulse(0),
+                      _shutter_from_open(false),
+                      _shutter_delay_ms(0),
+                      _camera_cued(false),
+                      _keep_cued(false) {}
+
+    void clear() {
+        _num_pulses = 0;
+    }
+
+    // Append a pulse.  Returns false if the sequence is full.
+    bool add_pulse(unsigned long gap_ms, unsigned long open_ms);
+
+    // Release the shutter delay_ms after the given pulse (counting
+    // from 0) opens or closes the valve.  A pulse past the end of the
+    // sequence, eg. NoPulse, leaves the shutter with no reference and
+    // the sequence won't compile.
+    void set_shutter(uint8_t pulse, bool from_open, unsigned long delay_ms) {
+        _shutter_pulse = pulse;
+        _shutter_from_open = from_open;
+        _shutter_delay_ms = delay_ms;
+    }
+
+    // Override the open time of one pulse, or the shutter delay, eg.
+    // when sweeping a parameter.
+    void set_pulse_open_time(uint8_t index, unsigned long open_ms) {
+        _pulses[index].open_ms = open_ms;
+    }
+
+    void set_shutter_delay(unsigned long delay_ms) {
+        _shutter_delay_ms = delay_ms;
+    }
+
+    // camera_cued: the cue relay is already closed and the camera is
+    // ready, so skip the ShutterPrepareTimeMillis wait.
+    // keep_cued: leave the cue relay closed at the end of the capture,
+    // ready for the next one.
+    void set_cue(bool camera_cued, bool keep_cued) {
+        _camera_cued = camera_cued;
+        _keep_cued = keep_cued;
+    }
+
+    inline uint8_t get_num_pulses() const {
+        return _num_pulses;
+    }
+
+    inline ValvePulse const &get_pulse(uint8_t index) const {
+        return _pulses[index];
+    }
+
+    inline bool has_shutter_reference() const {
+        return _shutter_pulse < _num_pulses;
+    }
+
+    // Compile the cue -> valve pulses -> shutter sequence into a
+    // timeline of relay edges.  Returns false if the shutter has no
+    // reference pulse or the timeline couldn't hold it.
+    bool compile(CaptureTimeline &timeline) const;
+
+private:
+
+    ValvePulse _pulses[MaxPulses];
+    uint8_t _num_pulses;
+
+    uint8_t _shutter_pulse;
+    bool _shutter_from_open;
+    unsigned long _shutter_delay_ms;
+
+    bool _camera_cued;
+    bool _keep_cued;
+};
+
+#endif